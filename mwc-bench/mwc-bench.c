@@ -0,0 +1,764 @@
+#define _GNU_SOURCE
+#include "ipc_shared.h"
+#include "xdg-shell-client-protocol.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+/* runs mwc on the headless backend, drives it with synthetic xdg-shell
+ * toplevels and the ipc, and reports how much work every scenario took */
+
+#define MAX_WINDOWS 256
+#define DEFAULT_WIDTH 640
+#define DEFAULT_HEIGHT 480
+#define DEFAULT_INNER_GAPS 4
+
+struct bench_window {
+  bool open;
+  struct wl_surface *surface;
+  struct xdg_surface *xdg_surface;
+  struct xdg_toplevel *xdg_toplevel;
+  int32_t width;
+  int32_t height;
+  int32_t pending_width;
+  int32_t pending_height;
+  bool has_buffer;
+};
+
+struct bench {
+  char dir[64];
+  char config_path[128];
+  char *compositor;
+  pid_t pid;
+
+  uint32_t window_count;
+  uint32_t rounds;
+
+  struct wl_display *display;
+  struct wl_registry *registry;
+  struct wl_compositor *wl_compositor;
+  struct wl_shm *shm;
+  struct xdg_wm_base *wm_base;
+
+  struct bench_window windows[MAX_WINDOWS];
+};
+
+/* what we sample from /proc/<pid> before and after a scenario */
+struct proc_sample {
+  uint64_t cpu_ticks;
+  uint64_t minor_faults;
+  uint64_t data_kb;
+};
+
+struct bench bench = {0};
+
+double
+now_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+void
+buffer_handle_release(void *data, struct wl_buffer *buffer) {
+  wl_buffer_destroy(buffer);
+}
+
+const struct wl_buffer_listener buffer_listener = {
+  .release = buffer_handle_release,
+};
+
+struct wl_buffer *
+create_buffer(int32_t width, int32_t height) {
+  int32_t stride = width * 4;
+  size_t size = stride * height;
+
+  int fd = memfd_create("mwc-bench", MFD_CLOEXEC);
+  if(fd < 0) return NULL;
+
+  if(ftruncate(fd, size) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  uint32_t *pixels = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(pixels == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+
+  /* opaque gray, contents dont matter */
+  for(size_t i = 0; i < size / 4; i++) {
+    pixels[i] = 0xff404040;
+  }
+  munmap(pixels, size);
+
+  struct wl_shm_pool *pool = wl_shm_create_pool(bench.shm, fd, size);
+  struct wl_buffer *buffer = wl_shm_pool_create_buffer(pool, 0, width, height,
+                                                       stride, WL_SHM_FORMAT_XRGB8888);
+  wl_shm_pool_destroy(pool);
+  close(fd);
+
+  wl_buffer_add_listener(buffer, &buffer_listener, NULL);
+  return buffer;
+}
+
+void
+xdg_surface_handle_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial) {
+  struct bench_window *window = data;
+  xdg_surface_ack_configure(xdg_surface, serial);
+
+  int32_t width = window->pending_width > 0 ? window->pending_width : DEFAULT_WIDTH;
+  int32_t height = window->pending_height > 0 ? window->pending_height : DEFAULT_HEIGHT;
+
+  /* like a real client we only redraw if the size changed */
+  if(!window->has_buffer || width != window->width || height != window->height) {
+    struct wl_buffer *buffer = create_buffer(width, height);
+    if(buffer == NULL) {
+      fprintf(stderr, "could not create a %dx%d buffer\n", width, height);
+    } else {
+      wl_surface_attach(window->surface, buffer, 0, 0);
+      wl_surface_damage_buffer(window->surface, 0, 0, width, height);
+      window->width = width;
+      window->height = height;
+      window->has_buffer = true;
+    }
+  }
+
+  wl_surface_commit(window->surface);
+}
+
+const struct xdg_surface_listener xdg_surface_listener = {
+  .configure = xdg_surface_handle_configure,
+};
+
+void
+xdg_toplevel_handle_configure(void *data, struct xdg_toplevel *xdg_toplevel,
+                              int32_t width, int32_t height, struct wl_array *states) {
+  struct bench_window *window = data;
+  window->pending_width = width;
+  window->pending_height = height;
+}
+
+void
+xdg_toplevel_handle_close(void *data, struct xdg_toplevel *xdg_toplevel) {
+  /* we close windows on our own terms */
+}
+
+void
+xdg_toplevel_handle_configure_bounds(void *data, struct xdg_toplevel *xdg_toplevel,
+                                     int32_t width, int32_t height) {
+  /* do nothing */
+}
+
+void
+xdg_toplevel_handle_wm_capabilities(void *data, struct xdg_toplevel *xdg_toplevel,
+                                    struct wl_array *capabilities) {
+  /* do nothing */
+}
+
+const struct xdg_toplevel_listener xdg_toplevel_listener = {
+  .configure = xdg_toplevel_handle_configure,
+  .close = xdg_toplevel_handle_close,
+  .configure_bounds = xdg_toplevel_handle_configure_bounds,
+  .wm_capabilities = xdg_toplevel_handle_wm_capabilities,
+};
+
+void
+wm_base_handle_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial) {
+  xdg_wm_base_pong(wm_base, serial);
+}
+
+const struct xdg_wm_base_listener wm_base_listener = {
+  .ping = wm_base_handle_ping,
+};
+
+void
+registry_handle_global(void *data, struct wl_registry *registry, uint32_t name,
+                       const char *interface, uint32_t version) {
+  if(strcmp(interface, wl_compositor_interface.name) == 0) {
+    bench.wl_compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+  } else if(strcmp(interface, wl_shm_interface.name) == 0) {
+    bench.shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+  } else if(strcmp(interface, xdg_wm_base_interface.name) == 0) {
+    bench.wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+    xdg_wm_base_add_listener(bench.wm_base, &wm_base_listener, NULL);
+  }
+}
+
+void
+registry_handle_global_remove(void *data, struct wl_registry *registry, uint32_t name) {
+  /* do nothing */
+}
+
+const struct wl_registry_listener registry_listener = {
+  .global = registry_handle_global,
+  .global_remove = registry_handle_global_remove,
+};
+
+void
+window_open(struct bench_window *window, uint32_t index) {
+  *window = (struct bench_window){0};
+  window->surface = wl_compositor_create_surface(bench.wl_compositor);
+  window->xdg_surface = xdg_wm_base_get_xdg_surface(bench.wm_base, window->surface);
+  xdg_surface_add_listener(window->xdg_surface, &xdg_surface_listener, window);
+  window->xdg_toplevel = xdg_surface_get_toplevel(window->xdg_surface);
+  xdg_toplevel_add_listener(window->xdg_toplevel, &xdg_toplevel_listener, window);
+
+  char title[32];
+  snprintf(title, sizeof(title), "bench %u", index);
+  xdg_toplevel_set_app_id(window->xdg_toplevel, "mwc-bench");
+  xdg_toplevel_set_title(window->xdg_toplevel, title);
+
+  /* initial commit, the buffer is attached on the first configure */
+  wl_surface_commit(window->surface);
+  window->open = true;
+}
+
+void
+window_close(struct bench_window *window) {
+  if(!window->open) return;
+
+  xdg_toplevel_destroy(window->xdg_toplevel);
+  xdg_surface_destroy(window->xdg_surface);
+  wl_surface_destroy(window->surface);
+  window->open = false;
+}
+
+/* keeps handling events until ms milliseconds pass */
+void
+dispatch_for(double ms) {
+  double deadline = now_ms() + ms;
+  int fd = wl_display_get_fd(bench.display);
+
+  while(1) {
+    while(wl_display_prepare_read(bench.display) != 0) {
+      wl_display_dispatch_pending(bench.display);
+    }
+    wl_display_flush(bench.display);
+
+    double remaining = deadline - now_ms();
+    if(remaining <= 0) {
+      wl_display_cancel_read(bench.display);
+      break;
+    }
+
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if(poll(&pfd, 1, remaining) > 0) {
+      if(wl_display_read_events(bench.display) < 0) {
+        fprintf(stderr, "lost the connection to the compositor\n");
+        exit(1);
+      }
+    } else {
+      wl_display_cancel_read(bench.display);
+    }
+
+    wl_display_dispatch_pending(bench.display);
+  }
+}
+
+void
+windows_open(uint32_t count) {
+  for(uint32_t i = 0; i < count; i++) {
+    window_open(&bench.windows[i], i);
+  }
+  wl_display_roundtrip(bench.display);
+}
+
+void
+windows_close(uint32_t count) {
+  for(uint32_t i = 0; i < count; i++) {
+    window_close(&bench.windows[i]);
+  }
+  wl_display_roundtrip(bench.display);
+}
+
+/* sends a request over the ipc and returns the whole reply, caller frees it */
+char *
+ipc_request(char *request) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd == -1) return NULL;
+
+  struct sockaddr_un address = {0};
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, IPC_PATH);
+
+  char line[IPC_MAX_REQUEST];
+  int line_len = snprintf(line, sizeof(line), "1 %s\n", request);
+
+  if(connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1
+     || write(fd, line, line_len) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  /* the reply is "reply 1 <length>\n" followed by length bytes */
+  size_t len = 0;
+  size_t cap = 1024;
+  char *reply = malloc(cap);
+  char *payload = NULL;
+  size_t payload_len = 0;
+  while(payload == NULL || len < (size_t)(payload - reply) + payload_len) {
+    if(cap - len < 512) {
+      cap *= 2;
+      size_t offset = payload != NULL ? payload - reply : 0;
+      reply = realloc(reply, cap);
+      if(payload != NULL) payload = reply + offset;
+    }
+
+    ssize_t n = read(fd, reply + len, cap - len - 1);
+    if(n <= 0) break;
+    len += n;
+    reply[len] = 0;
+
+    char *newline;
+    if(payload == NULL && (newline = strchr(reply, '\n')) != NULL) {
+      sscanf(reply, "reply %*u %zu", &payload_len);
+      payload = newline + 1;
+    }
+  }
+  close(fd);
+
+  if(payload == NULL) {
+    free(reply);
+    return NULL;
+  }
+
+  size_t header_len = payload - reply;
+  memmove(reply, payload, len - header_len);
+  reply[len - header_len] = 0;
+  return reply;
+}
+
+void
+ipc_dispatch(char *action) {
+  char request[256];
+  snprintf(request, sizeof(request), "dispatch %s", action);
+
+  char *reply = ipc_request(request);
+  if(reply == NULL || strcmp(reply, "ok\n") != 0) {
+    fprintf(stderr, "dispatching '%s' failed\n", action);
+  }
+  free(reply);
+}
+
+bool
+write_config(uint32_t master_count, uint32_t inner_gaps) {
+  char content[1024];
+  int len = snprintf(content, sizeof(content),
+                     "output HEADLESS-1 0 0 1920 1080 60\n"
+                     "workspace 1 HEADLESS-1\n"
+                     "workspace 2 HEADLESS-1\n"
+                     "master_count %u\n"
+                     "master_ratio 0.5\n"
+                     "animations 1\n"
+                     "animation_duration 200\n"
+                     "animation_curve 0.05 0.9 0.1 1.05\n"
+                     "border_width 2\n"
+                     "outer_gaps 8\n"
+                     "inner_gaps %u\n"
+                     "run \"echo $WAYLAND_DISPLAY > %s/run/display.tmp && mv %s/run/display.tmp %s/run/display\"\n",
+                     master_count, inner_gaps, bench.dir, bench.dir, bench.dir);
+
+  /* the compositor reloads on every modification, so the whole config goes
+   * out in a single write instead of truncating first */
+  int fd = open(bench.config_path, O_WRONLY | O_CREAT, 0600);
+  if(fd < 0) return false;
+
+  bool ok = write(fd, content, len) == len && ftruncate(fd, len) == 0;
+  close(fd);
+
+  return ok;
+}
+
+bool
+proc_sample(struct proc_sample *sample) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/stat", bench.pid);
+
+  FILE *stat = fopen(path, "r");
+  if(stat == NULL) return false;
+
+  char buffer[1024];
+  size_t len = fread(buffer, 1, sizeof(buffer) - 1, stat);
+  fclose(stat);
+  buffer[len] = 0;
+
+  /* the command name can contain spaces, so start after its closing paren */
+  char *p = strrchr(buffer, ')');
+  if(p == NULL) return false;
+
+  unsigned long minflt, utime, stime;
+  if(sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %lu %*u %*u %*u %lu %lu",
+            &minflt, &utime, &stime) != 3) {
+    return false;
+  }
+
+  sample->minor_faults = minflt;
+  sample->cpu_ticks = utime + stime;
+
+  snprintf(path, sizeof(path), "/proc/%d/status", bench.pid);
+  FILE *status = fopen(path, "r");
+  if(status == NULL) return false;
+
+  char line[256];
+  while(fgets(line, sizeof(line), status) != NULL) {
+    unsigned long kb;
+    if(sscanf(line, "VmData: %lu kB", &kb) == 1) {
+      sample->data_kb = kb;
+    }
+  }
+  fclose(status);
+
+  return true;
+}
+
+void
+report(char *name, struct proc_sample *before, struct proc_sample *after) {
+  double cpu_ms = (after->cpu_ticks - before->cpu_ticks) * 1000.0 / sysconf(_SC_CLK_TCK);
+
+  printf("%s: %u rounds, %u windows\n", name, bench.rounds, bench.window_count);
+  printf("  cpu %.1f ms, minor faults %ld, data %+ld kB\n", cpu_ms,
+         (long)(after->minor_faults - before->minor_faults),
+         (long)after->data_kb - (long)before->data_kb);
+
+  char *stats = ipc_request("frame-stats");
+  if(stats == NULL) {
+    fprintf(stderr, "could not get frame stats\n");
+    return;
+  }
+
+  char *saveptr;
+  for(char *line = strtok_r(stats, "\n", &saveptr); line != NULL;
+      line = strtok_r(NULL, "\n", &saveptr)) {
+    printf("  %s\n", line);
+  }
+  fflush(stdout);
+  free(stats);
+}
+
+void
+scenario_open_close(void) {
+  for(uint32_t i = 0; i < bench.rounds; i++) {
+    windows_open(bench.window_count);
+    dispatch_for(100);
+    windows_close(bench.window_count);
+    dispatch_for(100);
+  }
+}
+
+void
+scenario_workspace_switch(void) {
+  for(uint32_t i = 0; i < bench.rounds; i++) {
+    ipc_dispatch("workspace 2");
+    dispatch_for(50);
+    ipc_dispatch("workspace 1");
+    dispatch_for(50);
+  }
+}
+
+void
+scenario_swap(void) {
+  for(uint32_t i = 0; i < bench.rounds; i++) {
+    ipc_dispatch("swap left");
+    dispatch_for(50);
+    ipc_dispatch("swap right");
+    dispatch_for(50);
+    ipc_dispatch("swap up");
+    dispatch_for(50);
+    ipc_dispatch("swap down");
+    dispatch_for(50);
+  }
+}
+
+void
+scenario_master_count(void) {
+  for(uint32_t i = 0; i < bench.rounds; i++) {
+    write_config(bench.window_count / 2 > 0 ? bench.window_count / 2 : 1, DEFAULT_INNER_GAPS);
+    dispatch_for(250);
+    write_config(1, DEFAULT_INNER_GAPS);
+    dispatch_for(250);
+  }
+}
+
+void
+scenario_reload(void) {
+  /* the extra window makes everything animate, and we reload right after */
+  uint32_t extra = bench.window_count;
+  for(uint32_t i = 0; i < bench.rounds; i++) {
+    window_open(&bench.windows[extra], extra);
+    wl_display_roundtrip(bench.display);
+    /* an identical config is parsed but has nothing to apply,
+     * changing the gaps makes every workspace lay out again */
+    write_config(1, DEFAULT_INNER_GAPS * 2);
+    dispatch_for(100);
+    window_close(&bench.windows[extra]);
+    wl_display_roundtrip(bench.display);
+    write_config(1, DEFAULT_INNER_GAPS);
+    dispatch_for(100);
+  }
+}
+
+struct scenario {
+  char *name;
+  /* whether the windows should already be open when it starts */
+  bool needs_windows;
+  void (*run)(void);
+};
+
+struct scenario scenarios[] = {
+  { "open-close", false, scenario_open_close },
+  { "workspace-switch", true, scenario_workspace_switch },
+  { "swap", true, scenario_swap },
+  { "master-count", true, scenario_master_count },
+  { "reload", true, scenario_reload },
+};
+
+#define SCENARIO_COUNT (sizeof(scenarios) / sizeof(scenarios[0]))
+
+void
+run_scenario(struct scenario *scenario) {
+  if(scenario->needs_windows) {
+    windows_open(bench.window_count);
+  }
+
+  /* let the opening animations finish, they are not part of this scenario */
+  dispatch_for(500);
+
+  free(ipc_request("frame-stats-reset"));
+
+  struct proc_sample before = {0}, after = {0};
+  proc_sample(&before);
+
+  scenario->run();
+  dispatch_for(500);
+
+  proc_sample(&after);
+  report(scenario->name, &before, &after);
+
+  if(scenario->needs_windows) {
+    windows_close(bench.window_count);
+  }
+  /* the config might have been changed by the scenario */
+  write_config(1, DEFAULT_INNER_GAPS);
+}
+
+bool
+start_compositor(void) {
+  char run_dir[96];
+  snprintf(run_dir, sizeof(run_dir), "%s/run", bench.dir);
+  /* the compositor watches the directory of the config, so everything
+   * else we create goes into a subdirectory */
+  if(mkdir(run_dir, 0700) < 0) return false;
+
+  if(!write_config(1, DEFAULT_INNER_GAPS)) return false;
+
+  bench.pid = fork();
+  if(bench.pid < 0) return false;
+
+  if(bench.pid == 0) {
+    char log_path[128];
+    snprintf(log_path, sizeof(log_path), "%s/log", run_dir);
+    int log = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(log >= 0) {
+      dup2(log, 1);
+      dup2(log, 2);
+      close(log);
+    }
+
+    setenv("MWC_CONFIG_PATH", bench.config_path, true);
+    setenv("WLR_BACKENDS", "headless", true);
+    setenv("WLR_HEADLESS_OUTPUTS", "1", true);
+    setenv("WLR_LIBINPUT_NO_DEVICES", "1", true);
+    execlp(bench.compositor, bench.compositor, NULL);
+    _exit(127);
+  }
+
+  /* the compositor writes its socket name once it is ready */
+  char display_path[128];
+  snprintf(display_path, sizeof(display_path), "%s/display", run_dir);
+
+  double deadline = now_ms() + 10000;
+  while(access(display_path, F_OK) != 0) {
+    if(now_ms() > deadline || waitpid(bench.pid, NULL, WNOHANG) != 0) {
+      fprintf(stderr, "the compositor did not start, see %s/log\n", run_dir);
+      return false;
+    }
+    usleep(10000);
+  }
+
+  char socket_name[64] = {0};
+  FILE *display = fopen(display_path, "r");
+  if(display == NULL || fgets(socket_name, sizeof(socket_name), display) == NULL) {
+    if(display != NULL) fclose(display);
+    return false;
+  }
+  fclose(display);
+  socket_name[strcspn(socket_name, "\n")] = 0;
+
+  bench.display = wl_display_connect(socket_name);
+  if(bench.display == NULL) return false;
+
+  bench.registry = wl_display_get_registry(bench.display);
+  wl_registry_add_listener(bench.registry, &registry_listener, NULL);
+  wl_display_roundtrip(bench.display);
+
+  if(bench.wl_compositor == NULL || bench.shm == NULL || bench.wm_base == NULL) {
+    fprintf(stderr, "the compositor is missing some globals\n");
+    return false;
+  }
+
+  return true;
+}
+
+void
+stop_compositor(void) {
+  if(bench.display != NULL) {
+    wl_display_disconnect(bench.display);
+  }
+
+  if(bench.pid <= 0) return;
+
+  free(ipc_request("dispatch exit"));
+
+  double deadline = now_ms() + 2000;
+  while(waitpid(bench.pid, NULL, WNOHANG) == 0) {
+    if(now_ms() > deadline) {
+      kill(bench.pid, SIGKILL);
+      waitpid(bench.pid, NULL, 0);
+      /* it did not get to clean up after itself */
+      unlink(IPC_PATH);
+      break;
+    }
+    usleep(10000);
+  }
+}
+
+void
+remove_dir(void) {
+  char path[160];
+  char *run_files[] = { "display", "display.tmp" };
+  for(size_t i = 0; i < sizeof(run_files) / sizeof(run_files[0]); i++) {
+    snprintf(path, sizeof(path), "%s/run/%s", bench.dir, run_files[i]);
+    unlink(path);
+  }
+  unlink(bench.config_path);
+}
+
+void
+usage(void) {
+  fprintf(stderr,
+          "usage: mwc-bench [-c compositor] [-n windows] [-r rounds] [scenario...]\n"
+          "runs mwc on the headless backend and reports the cost of every scenario\n"
+          "  -c - compositor to run, defaults to mwc\n"
+          "  -n - number of windows, defaults to 16\n"
+          "  -r - how many times each scenario repeats, defaults to 10\n"
+          "scenarios (all of them by default):\n");
+  for(size_t i = 0; i < SCENARIO_COUNT; i++) {
+    fprintf(stderr, "  %s\n", scenarios[i].name);
+  }
+}
+
+int
+main(int argc, char *argv[]) {
+  bench.compositor = "mwc";
+  bench.window_count = 16;
+  bench.rounds = 10;
+
+  int opt;
+  while((opt = getopt(argc, argv, "c:n:r:h")) != -1) {
+    switch(opt) {
+      case 'c':
+        bench.compositor = optarg;
+        break;
+      case 'n':
+        bench.window_count = atoi(optarg);
+        break;
+      case 'r':
+        bench.rounds = atoi(optarg);
+        break;
+      default:
+        usage();
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  /* one slot is kept for the extra window in the reload scenario */
+  if(bench.window_count < 1 || bench.window_count > MAX_WINDOWS - 1) {
+    fprintf(stderr, "number of windows has to be between 1 and %d\n", MAX_WINDOWS - 1);
+    return 1;
+  }
+
+  bool selected[SCENARIO_COUNT] = {0};
+  bool any_selected = false;
+  for(int i = optind; i < argc; i++) {
+    bool found = false;
+    for(size_t j = 0; j < SCENARIO_COUNT; j++) {
+      if(strcmp(argv[i], scenarios[j].name) == 0) {
+        selected[j] = true;
+        found = true;
+      }
+    }
+
+    if(!found) {
+      fprintf(stderr, "unknown scenario %s\n", argv[i]);
+      usage();
+      return 1;
+    }
+    any_selected = true;
+  }
+
+  /* the ipc socket path is fixed, so we would take over a running session */
+  if(access(IPC_PATH, F_OK) == 0) {
+    fprintf(stderr, "%s exists, is mwc already running?\n", IPC_PATH);
+    return 1;
+  }
+
+  strcpy(bench.dir, "/tmp/mwc-bench-XXXXXX");
+  if(mkdtemp(bench.dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  snprintf(bench.config_path, sizeof(bench.config_path), "%s/mwc.conf", bench.dir);
+
+  int status = 0;
+  if(!start_compositor()) {
+    fprintf(stderr, "could not start %s\n", bench.compositor);
+    status = 1;
+    goto cleanup;
+  }
+
+  for(size_t i = 0; i < SCENARIO_COUNT; i++) {
+    if(any_selected && !selected[i]) continue;
+    run_scenario(&scenarios[i]);
+  }
+
+cleanup:
+  stop_compositor();
+  remove_dir();
+  /* the log is kept around in case something went wrong */
+  if(status == 0) {
+    char path[160];
+    snprintf(path, sizeof(path), "%s/run/log", bench.dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/run", bench.dir);
+    rmdir(path);
+    rmdir(bench.dir);
+  }
+
+  return status;
+}
@@ -1,56 +1,309 @@
 #include "ipc_shared.h"
 
+#include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 
-void
-ipc_subscribe(int fd) {
-  if(write(fd, "subscribe", strlen("subscribe")) < 0) {
+struct ipc_reader {
+  int fd;
+  char *buffer;
+  size_t start;
+  size_t len;
+  size_t cap;
+};
+
+struct ipc_frame {
+  /* "reply" or "event" */
+  char kind[8];
+  unsigned int id;
+  /* points into the reader's buffer, valid until the next read, not terminated */
+  char *payload;
+  size_t len;
+};
+
+/* a single read of whatever the socket has, returns false on eof or error */
+bool
+ipc_reader_fill(struct ipc_reader *reader) {
+  if(reader->start > 0) {
+    memmove(reader->buffer, reader->buffer + reader->start, reader->len);
+    reader->start = 0;
+  }
+
+  /* replies can be any size, so the buffer grows to fit the biggest one */
+  if(reader->cap - reader->len < 1024) {
+    reader->cap = reader->cap == 0 ? 4096 : reader->cap * 2;
+    reader->buffer = realloc(reader->buffer, reader->cap);
+  }
+
+  ssize_t n = read(reader->fd, reader->buffer + reader->len, reader->cap - reader->len);
+  if(n <= 0) return false;
+
+  reader->len += n;
+  return true;
+}
+
+/* takes the next frame out of what was already read, false if it is not all there yet */
+bool
+ipc_parse_frame(struct ipc_reader *reader, struct ipc_frame *frame) {
+  char *header = reader->buffer + reader->start;
+  char *newline = memchr(header, '\n', reader->len);
+  if(newline == NULL) return false;
+
+  *newline = 0;
+  int parsed = sscanf(header, "%7s %u %zu", frame->kind, &frame->id, &frame->len);
+  *newline = '\n';
+  if(parsed != 3) {
+    fprintf(stderr, "invalid reply from the compositor\n");
+    exit(1);
+  }
+
+  size_t header_len = newline + 1 - header;
+  if(reader->len < header_len + frame->len) return false;
+
+  frame->payload = newline + 1;
+  reader->start += header_len + frame->len;
+  reader->len -= header_len + frame->len;
+
+  return true;
+}
+
+/* blocks until a whole frame is read */
+bool
+ipc_read_frame(struct ipc_reader *reader, struct ipc_frame *frame) {
+  while(!ipc_parse_frame(reader, frame)) {
+    if(!ipc_reader_fill(reader)) return false;
+  }
+  return true;
+}
+
+bool
+ipc_send(int fd, unsigned int id, char *message) {
+  char request[IPC_MAX_REQUEST];
+  int len = snprintf(request, sizeof(request), "%u %s\n", id, message);
+  if(len >= (int)sizeof(request)) {
+    fprintf(stderr, "the message is too long\n");
+    return false;
+  }
+
+  if(write(fd, request, len) < 0) {
     printf("failed to write the message, is the server running?\n");
-    return;
-  };
+    return false;
+  }
+  return true;
+}
+
+void
+json_print_string(const char *string, size_t len) {
+  putchar('"');
+  for(size_t i = 0; i < len; i++) {
+    unsigned char c = string[i];
+    if(c == '"' || c == '\\') {
+      printf("\\%c", c);
+    } else if(c == '\n') {
+      printf("\\n");
+    } else if(c < 0x20) {
+      printf("\\u%04x", c);
+    } else {
+      putchar(c);
+    }
+  }
+  putchar('"');
+}
+
+/* one object per line, the payload split into lines and the lines into fields */
+void
+json_print_frame(struct ipc_frame *frame) {
+  printf("{\"type\":\"%s\",\"id\":%u,\"lines\":[", frame->kind, frame->id);
+
+  const char *line = frame->payload;
+  const char *end = frame->payload + frame->len;
+  bool first_line = true;
+  while(line < end) {
+    const char *line_end = memchr(line, '\n', end - line);
+    if(line_end == NULL) line_end = end;
+
+    printf(first_line ? "[" : ",[");
+    first_line = false;
 
-  char buffer[1024];
-  while(1) {
-    ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
-    if(len <= 0) return;
+    /* fields are terminated by the separator, a trailing one does not start a new field */
+    const char *field = line;
+    bool first_field = true;
+    while(field < line_end) {
+      /* the separator is a single byte */
+      const char *field_end = memchr(field, SEPARATOR[0], line_end - field);
+      if(field_end == NULL) field_end = line_end;
 
-    buffer[len] = 0;
-    printf("%s", buffer);
-    fflush(stdout);
+      if(!first_field) putchar(',');
+      first_field = false;
+      json_print_string(field, field_end - field);
+
+      field = field_end == line_end ? line_end : field_end + 1;
+    }
+    putchar(']');
+
+    line = line_end + 1;
   }
+
+  printf("]}\n");
 }
 
 void
-ipc_simple(int fd, char *message) {
-  if(write(fd, message, strlen(message)) < 0) {
-    printf("failed to write the message, is the server running?\n");
-    return;
-  };
+print_frame(struct ipc_frame *frame, bool json) {
+  if(json) {
+    json_print_frame(frame);
+  } else {
+    fwrite(frame->payload, 1, frame->len, stdout);
+  }
+}
+
+void
+ipc_subscribe(int fd, char *message, bool json) {
+  if(!ipc_send(fd, 1, message)) return;
+
+  struct ipc_reader reader = { .fd = fd };
+  struct ipc_frame frame;
+  while(ipc_read_frame(&reader, &frame)) {
+    /* the reply is either ok or an error, the events follow it */
+    bool ok = frame.len == strlen("ok\n") && memcmp(frame.payload, "ok\n", frame.len) == 0;
+    if(json || strcmp(frame.kind, "event") == 0 || !ok) {
+      print_frame(&frame, json);
+      fflush(stdout);
+    }
+  }
+  free(reader.buffer);
+}
 
-  char buffer[1024];
-  ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
-  if(len <= 0) return;
+void
+ipc_simple(int fd, char *message, bool json) {
+  if(!ipc_send(fd, 1, message)) return;
 
-  buffer[len] = 0;
-  printf("%s", buffer);
+  struct ipc_reader reader = { .fd = fd };
+  struct ipc_frame frame;
+  if(ipc_read_frame(&reader, &frame)) {
+    print_frame(&frame, json);
+  }
   fflush(stdout);
+  free(reader.buffer);
+}
+
+/* sends every line of stdin as a request over the same connection without waiting
+ * for the replies, and prints the replies as they come */
+int
+ipc_stdin(int fd, bool json) {
+  struct ipc_reader reader = { .fd = fd };
+  char input[IPC_MAX_REQUEST];
+  size_t input_len = 0;
+
+  unsigned int sent = 0;
+  unsigned int answered = 0;
+  bool subscribed = false;
+  bool stdin_open = true;
+
+  /* after stdin is closed we stay until every request is answered,
+   * or until the compositor goes away if there is a subscription */
+  while(stdin_open || answered < sent || subscribed) {
+    struct pollfd fds[2] = {
+      { .fd = fd, .events = POLLIN },
+      { .fd = STDIN_FILENO, .events = POLLIN },
+    };
+    if(poll(fds, stdin_open ? 2 : 1, -1) < 0) {
+      perror("poll");
+      return 1;
+    }
+
+    if(fds[0].revents) {
+      if(!ipc_reader_fill(&reader)) break;
+
+      struct ipc_frame frame;
+      while(ipc_parse_frame(&reader, &frame)) {
+        if(strcmp(frame.kind, "reply") == 0) {
+          answered++;
+        }
+        print_frame(&frame, json);
+      }
+      fflush(stdout);
+    }
+
+    if(stdin_open && fds[1].revents) {
+      ssize_t n = read(STDIN_FILENO, input + input_len, sizeof(input) - input_len);
+      if(n <= 0) {
+        stdin_open = false;
+        /* the last line does not have to end with a newline, there is always
+         * room for one since a full buffer without any is an error below */
+        if(input_len == 0) continue;
+        input[input_len] = '\n';
+        n = 1;
+      }
+      input_len += n;
+
+      char *start = input;
+      char *end = input + input_len;
+      char *newline;
+      while((newline = memchr(start, '\n', end - start)) != NULL) {
+        *newline = 0;
+        if(*start != 0) {
+          sent++;
+          if(!ipc_send(fd, sent, start)) return 1;
+          if(strncmp(start, "subscribe", strlen("subscribe")) == 0) {
+            subscribed = true;
+          }
+        }
+        start = newline + 1;
+      }
+
+      input_len = end - start;
+      memmove(input, start, input_len);
+      if(input_len == sizeof(input)) {
+        fprintf(stderr, "the message is too long\n");
+        return 1;
+      }
+    }
+  }
+
+  free(reader.buffer);
+  return 0;
 }
 
 int
 main(int argc, char *argv[]) {
-  if(argc < 2 || strcmp(argv[1], "-h") == 0) {
+  bool json = false;
+  bool from_stdin = false;
+
+  int arg = 1;
+  while(arg < argc) {
+    if(strcmp(argv[arg], "--json") == 0) {
+      json = true;
+    } else if(strcmp(argv[arg], "--stdin") == 0) {
+      from_stdin = true;
+    } else {
+      break;
+    }
+    arg++;
+  }
+
+  if((arg == argc && !from_stdin) || (arg < argc && strcmp(argv[arg], "-h") == 0)) {
     fprintf(stderr,
-            "usage: mwc-ipc message\n"
+            "usage: mwc-ipc [--json] message\n"
+            "       mwc-ipc [--json] --stdin\n"
             "where message is one of\n"
-            "  subscribe - receive all the events from the compositor\n"
+            "  \"subscribe [events]\" - receive events from the compositor, active-workspace and\n"
+            "    active-toplevel if none are given. \"tree\" sends the whole window tree and then\n"
+            "    only what changes in it, with windows identified by ids that never change\n"
             "  toplevels - list app_ids and titles of all the toplevels\n"
             "  layers - list namespaces of all the layers\n"
-            "  outputs - list names of all the outputs\n");
+            "  outputs - list names of all the outputs\n"
+            "  frame-stats - frame timing statistics for all the outputs, in microseconds\n"
+            "  frame-stats-reset - clear the frame timing statistics\n"
+            "  \"dispatch <action> [args]\" - run a keybind action, e.g. \"dispatch workspace 2\"\n"
+            "--stdin sends every line of the standard input as a message over a single connection,\n"
+            "without waiting for the replies in between\n"
+            "--json prints every reply and event as a json object on its own line, with the lines\n"
+            "of the reply split into their fields\n");
     return 0;
   }
 
@@ -70,13 +323,22 @@ main(int argc, char *argv[]) {
     return 1;
   }
 
-  if(strcmp(argv[1], "subscribe") == 0) {
-    ipc_subscribe(fd);
+  int status = 0;
+  if(from_stdin) {
+    status = ipc_stdin(fd, json);
+  } else if(strncmp(argv[arg], "subscribe", strlen("subscribe")) == 0) {
+    /* both "mwc-ipc subscribe active-toplevel" and "mwc-ipc 'subscribe active-toplevel'" work */
+    char message[256];
+    size_t len = 0;
+    for(int i = arg; i < argc && len < sizeof(message); i++) {
+      len += snprintf(message + len, sizeof(message) - len, i == arg ? "%s" : " %s", argv[i]);
+    }
+    ipc_subscribe(fd, message, json);
   } else {
-    ipc_simple(fd, argv[1]);
+    ipc_simple(fd, argv[arg], json);
   }
 
   close(fd);
 
-  return 0;
+  return status;
 }
@@ -13,8 +13,13 @@
 #include "toplevel.h"
 #include "layout.h"
 
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <assert.h>
+#include <fcntl.h>
 #include <libinput.h>
 #include <stddef.h>
 #include <limits.h>
@@ -68,29 +73,58 @@ parse_color_rgba_or_hex(char **args, size_t arg_count, float *dest) {
 }
 
 struct vec2
-calculate_animation_curve_at(struct mwc_config *c, double t) {
+calculate_animation_curve_at(struct bezier_curve *curve, double t) {
   struct vec2 point;
 
-  point.x = 3 * t * (1 - t) * (1 - t) * c->animation_curve[0]
-    + 3 * t * t * (1 - t) * c->animation_curve[2]
+  point.x = 3 * t * (1 - t) * (1 - t) * curve->control_points[0]
+    + 3 * t * t * (1 - t) * curve->control_points[2]
     + t * t * t;
 
-  point.y = 3 * t * (1 - t) * (1 - t) * c->animation_curve[1]
-    + 3 * t * t * (1 - t) * c->animation_curve[3]
+  point.y = 3 * t * (1 - t) * (1 - t) * curve->control_points[1]
+    + 3 * t * t * (1 - t) * curve->control_points[3]
     + t * t * t;
 
   return point;
 }
 
 /* thanks vaxry */
-void bake_bezier_curve_points(struct mwc_config *c) {
-  c->baked_points = calloc(BAKED_POINTS_COUNT, sizeof(*c->baked_points));
-
+void
+bake_bezier_curve_points(struct bezier_curve *curve) {
+  /* the curve is parametrized by t, but we are asked for y at some x. we solve
+   * for t at uniformly spaced x values here once, so looking a value up later
+   * is just an interpolation between two neighbouring points */
+  double low = 0;
   for(size_t i = 0; i < BAKED_POINTS_COUNT; i++) {
-    c->baked_points[i] = calculate_animation_curve_at(c, (double)i / (BAKED_POINTS_COUNT - 1));
+    double x = (double)i / (BAKED_POINTS_COUNT - 1);
+
+    /* x(t) is increasing for sane control points, so t only grows with x */
+    double high = 1;
+    for(size_t j = 0; j < 32; j++) {
+      double middle = (low + high) / 2;
+      if(calculate_animation_curve_at(curve, middle).x < x) {
+        low = middle;
+      } else {
+        high = middle;
+      }
+    }
+
+    curve->baked_points[i] = calculate_animation_curve_at(curve, (low + high) / 2).y;
   }
 }
 
+double
+bezier_curve_sample(struct bezier_curve *curve, double x) {
+  if(x <= 0) return curve->baked_points[0];
+  if(x >= 1) return curve->baked_points[BAKED_POINTS_COUNT - 1];
+
+  double position = x * (BAKED_POINTS_COUNT - 1);
+  size_t i = position;
+  double fraction = position - i;
+
+  return curve->baked_points[i]
+    + (curve->baked_points[i + 1] - curve->baked_points[i]) * fraction;
+}
+
 bool
 config_add_layer_rule(struct mwc_config *c, char *regex, char *predicate,
                       char **args, size_t arg_count) {
@@ -107,6 +141,7 @@ config_add_layer_rule(struct mwc_config *c, char *regex, char *predicate,
       condition.regex = compiled;
       condition.has = true;
     }
+    condition.source = strdup(regex);
 
   if(strcmp(predicate, "blur") == 0) {
     struct layer_rule_blur *lr = calloc(1, sizeof(*lr));
@@ -117,6 +152,7 @@ config_add_layer_rule(struct mwc_config *c, char *regex, char *predicate,
     if(condition.has) {
       regfree(&condition.regex);
     }
+    free(condition.source);
     return false;
   }
 
@@ -126,31 +162,13 @@ config_add_layer_rule(struct mwc_config *c, char *regex, char *predicate,
 bool
 config_add_window_rule(struct mwc_config *c, char *app_id_regex, char *title_regex,
                        char *predicate, char **args, size_t arg_count) {
-  struct window_rule_regex condition;
-  if(strcmp(app_id_regex, "_") == 0) {
-    condition.has_app_id_regex = false;
-  } else {
-    regex_t compiled;
-    if(regcomp(&compiled, app_id_regex, REG_EXTENDED) != 0) {
-      wlr_log(WLR_ERROR, "%s is not a valid regex", app_id_regex);
-      regfree(&compiled);
-      return false;
-    }
-    condition.app_id_regex = compiled;
-    condition.has_app_id_regex = true;
+  struct window_rule_condition condition;
+  if(!window_rule_pattern_compile(&condition.app_id, app_id_regex)) {
+    return false;
   }
-
-  if(strcmp(title_regex, "_") == 0) {
-    condition.has_title_regex = false;
-  } else {
-    regex_t compiled;
-    if(regcomp(&compiled, title_regex, REG_EXTENDED) != 0) {
-      wlr_log(WLR_ERROR, "%s is not a valid regex", title_regex);
-      regfree(&compiled);
-      return false;
-    }
-    condition.title_regex = compiled;
-    condition.has_title_regex = true;
+  if(!window_rule_pattern_compile(&condition.title, title_regex)) {
+    window_rule_pattern_finish(&condition.app_id);
+    return false;
   }
 
   if(strcmp(predicate, "float") == 0) {
@@ -203,12 +221,7 @@ config_add_window_rule(struct mwc_config *c, char *app_id_regex, char *title_reg
   return true;
 
 invalid:
-  if(condition.has_app_id_regex) {
-    regfree(&condition.app_id_regex);
-  }
-  if(condition.has_title_regex) {
-    regfree(&condition.title_regex);
-  }
+  window_rule_condition_finish(&condition);
   return false;
 }
 
@@ -243,113 +256,25 @@ string_append_with_comma(char *a, char *b, size_t *cap, bool comma) {
 void
 config_add_keymap(struct mwc_config *c, char *layout, char *variant) {
   /* everything here is ugly */
-  static size_t layout_cap, variant_cap;
-  static size_t count;
   if(c->keymap_layouts == 0) {
     /* it has not been allocated yet */
-    layout_cap = STRING_INITIAL_LENGTH;
-    c->keymap_layouts = calloc(layout_cap, sizeof(char));
-    variant_cap = STRING_INITIAL_LENGTH;
-    c->keymap_variants = calloc(variant_cap, sizeof(char));
-    count = 0;
+    c->keymap_layouts_cap = STRING_INITIAL_LENGTH;
+    c->keymap_layouts = calloc(c->keymap_layouts_cap, sizeof(char));
+    c->keymap_variants_cap = STRING_INITIAL_LENGTH;
+    c->keymap_variants = calloc(c->keymap_variants_cap, sizeof(char));
+    c->keymap_count = 0;
   }
 
-  c->keymap_layouts = string_append_with_comma(c->keymap_layouts, layout, &layout_cap, count);
-  c->keymap_variants = string_append_with_comma(c->keymap_variants, variant, &variant_cap, count);
+  c->keymap_layouts = string_append_with_comma(c->keymap_layouts, layout,
+                                               &c->keymap_layouts_cap, c->keymap_count);
+  c->keymap_variants = string_append_with_comma(c->keymap_variants, variant,
+                                                &c->keymap_variants_cap, c->keymap_count);
 
-  count++;
+  c->keymap_count++;
 }
 
 bool
-config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
-                   char* action, char **args, size_t arg_count) {
-  char *p = modifiers;
-  uint32_t modifiers_flag = 0;
-
-  while(*p != '\0') {
-    char mod[64] = {0};
-    char *q = mod;
-    while(*p != '+' && *p != '\0') {
-      *q = *p;
-      p++;
-      q++;
-    }
-
-    if(strcmp(mod, "alt") == 0) {
-      modifiers_flag |= WLR_MODIFIER_ALT;
-    } else if(strcmp(mod, "super") == 0) {
-      modifiers_flag |= WLR_MODIFIER_LOGO;
-    } else if(strcmp(mod, "ctrl") == 0) {
-      modifiers_flag |= WLR_MODIFIER_CTRL;
-    } else if(strcmp(mod, "shift") == 0) {
-      modifiers_flag |= WLR_MODIFIER_SHIFT;
-    }
-
-    if(*p == '+') {
-      p++;
-    }
-  }
-
-  uint32_t key_sym = 0;
-  bool pointer = false;
-  if(strncmp(key, "mouse_", 6) == 0) {
-    pointer = true;
-    key = key + 6;
-    if(strcmp(key, "left_click") == 0) {
-      key_sym = 272;
-    } else if(strcmp(key, "right_click") == 0) {
-      key_sym = 273;
-    } else if(strcmp(key, "middle_click") == 0) {
-      key_sym = 274;
-    } else {
-      key_sym = atoi(key);
-    }
-  } else if(strncmp(key, "pointer_", 8) == 0) {
-    pointer = true;
-    key = key + 8;
-    if(strcmp(key, "left_click") == 0) {
-      key_sym = 272;
-    } else if(strcmp(key, "right_click") == 0) {
-      key_sym = 273;
-    } else if(strcmp(key, "middle_click") == 0) {
-      key_sym = 274;
-    } else {
-      key_sym = atoi(key);
-    }
-  } else {
-    if(strcmp(key, "return") == 0 || strcmp(key, "enter") == 0) {
-      key_sym = XKB_KEY_Return;
-    } else if(strcmp(key, "backspace") == 0) {
-      key_sym = XKB_KEY_BackSpace;
-    } else if(strcmp(key, "delete") == 0) {
-      key_sym = XKB_KEY_Delete;
-    } else if(strcmp(key, "escape") == 0) {
-      key_sym = XKB_KEY_Escape;
-    } else if(strcmp(key, "tab") == 0) {
-      key_sym = XKB_KEY_Tab;
-    } else if(strcmp(key, "up") == 0) {
-      key_sym = XKB_KEY_Up;
-    } else if(strcmp(key, "down") == 0) {
-      key_sym = XKB_KEY_Down;
-    } else if(strcmp(key, "left") == 0) {
-      key_sym = XKB_KEY_Left;
-    } else if(strcmp(key, "right") == 0) {
-      key_sym = XKB_KEY_Right;
-    } else {
-      key_sym = xkb_keysym_from_name(key, 0);
-      if(key_sym == 0) {
-        wlr_log(WLR_ERROR, "key %s doesn't seem right", key);
-        return false;
-      }
-    }
-  }
-
-  struct keybind *k = calloc(1, sizeof(*k));
-  *k = (struct keybind){
-    .modifiers = modifiers_flag,
-    .key = key_sym,
-  };
-
+config_parse_keybind_action(struct keybind *k, char *action, char **args, size_t arg_count) {
   /* this is true for most, needs to be set to false if otherwise */
   k->initialized = true;
 
@@ -358,7 +283,6 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
   } else if(strcmp(action, "run") == 0) {
     if(arg_count < 1) {
       wlr_log(WLR_ERROR, "invalid args to %s", action);
-      free(k);
       return false;
     }
 
@@ -379,7 +303,6 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
   } else if(strcmp(action, "move_focus") == 0) {
     if(arg_count < 1) {
       wlr_log(WLR_ERROR, "invalid args to %s", action);
-      free(k);
       return false;
     }
 
@@ -394,7 +317,6 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
       direction = MWC_RIGHT;
     } else {
       wlr_log(WLR_ERROR, "invalid args to %s", action);
-      free(k);
       return false;
     }
 
@@ -403,7 +325,6 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
   } else if(strcmp(action, "swap") == 0) {
     if(arg_count < 1) {
       wlr_log(WLR_ERROR, "invalid args to %s", action);
-      free(k);
       return false;
     }
 
@@ -418,7 +339,6 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
       direction = MWC_RIGHT;
     } else {
       wlr_log(WLR_ERROR, "invalid args to %s", action);
-      free(k);
       return false;
     }
 
@@ -427,7 +347,6 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
   } else if(strcmp(action, "workspace") == 0) {
     if(arg_count < 1) {
       wlr_log(WLR_ERROR, "invalid args to %s", action);
-      free(k);
       return false;
     }
     k->action = keybind_change_workspace;
@@ -437,7 +356,6 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
   } else if(strcmp(action, "move_to_workspace") == 0) {
     if(arg_count < 1) {
       wlr_log(WLR_ERROR, "invalid args to %s", action);
-      free(k);
       return false;
     }
     k->action = keybind_move_focused_toplevel_to_workspace;
@@ -452,8 +370,119 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
     k->action = keybind_focused_toplevel_toggle_fullscreen;
   } else if(strcmp(action, "reload_config") == 0) {
     k->action = keybind_reload_config;
+  } else if(strcmp(action, "layout") == 0) {
+    if(arg_count < 1) {
+      wlr_log(WLR_ERROR, "invalid args to %s", action);
+      return false;
+    }
+
+    const struct mwc_layout *layout = layout_from_name(args[0]);
+    if(layout == NULL) {
+      wlr_log(WLR_ERROR, "there is no layout %s", args[0]);
+      return false;
+    }
+
+    k->action = keybind_set_layout;
+    k->args = (void *)layout;
   } else {
     wlr_log(WLR_ERROR, "invalid keybind action %s", action);
+    return false;
+  }
+
+  return true;
+}
+
+bool
+config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
+                   char* action, char **args, size_t arg_count) {
+  char *p = modifiers;
+  uint32_t modifiers_flag = 0;
+
+  while(*p != '\0') {
+    char mod[64] = {0};
+    char *q = mod;
+    while(*p != '+' && *p != '\0') {
+      *q = *p;
+      p++;
+      q++;
+    }
+
+    if(strcmp(mod, "alt") == 0) {
+      modifiers_flag |= WLR_MODIFIER_ALT;
+    } else if(strcmp(mod, "super") == 0) {
+      modifiers_flag |= WLR_MODIFIER_LOGO;
+    } else if(strcmp(mod, "ctrl") == 0) {
+      modifiers_flag |= WLR_MODIFIER_CTRL;
+    } else if(strcmp(mod, "shift") == 0) {
+      modifiers_flag |= WLR_MODIFIER_SHIFT;
+    }
+
+    if(*p == '+') {
+      p++;
+    }
+  }
+
+  uint32_t key_sym = 0;
+  bool pointer = false;
+  if(strncmp(key, "mouse_", 6) == 0) {
+    pointer = true;
+    key = key + 6;
+    if(strcmp(key, "left_click") == 0) {
+      key_sym = 272;
+    } else if(strcmp(key, "right_click") == 0) {
+      key_sym = 273;
+    } else if(strcmp(key, "middle_click") == 0) {
+      key_sym = 274;
+    } else {
+      key_sym = atoi(key);
+    }
+  } else if(strncmp(key, "pointer_", 8) == 0) {
+    pointer = true;
+    key = key + 8;
+    if(strcmp(key, "left_click") == 0) {
+      key_sym = 272;
+    } else if(strcmp(key, "right_click") == 0) {
+      key_sym = 273;
+    } else if(strcmp(key, "middle_click") == 0) {
+      key_sym = 274;
+    } else {
+      key_sym = atoi(key);
+    }
+  } else {
+    if(strcmp(key, "return") == 0 || strcmp(key, "enter") == 0) {
+      key_sym = XKB_KEY_Return;
+    } else if(strcmp(key, "backspace") == 0) {
+      key_sym = XKB_KEY_BackSpace;
+    } else if(strcmp(key, "delete") == 0) {
+      key_sym = XKB_KEY_Delete;
+    } else if(strcmp(key, "escape") == 0) {
+      key_sym = XKB_KEY_Escape;
+    } else if(strcmp(key, "tab") == 0) {
+      key_sym = XKB_KEY_Tab;
+    } else if(strcmp(key, "up") == 0) {
+      key_sym = XKB_KEY_Up;
+    } else if(strcmp(key, "down") == 0) {
+      key_sym = XKB_KEY_Down;
+    } else if(strcmp(key, "left") == 0) {
+      key_sym = XKB_KEY_Left;
+    } else if(strcmp(key, "right") == 0) {
+      key_sym = XKB_KEY_Right;
+    } else {
+      key_sym = xkb_keysym_from_name(key, 0);
+      if(key_sym == 0) {
+        wlr_log(WLR_ERROR, "key %s doesn't seem right", key);
+        return false;
+      }
+    }
+  }
+
+  struct keybind *k = calloc(1, sizeof(*k));
+  *k = (struct keybind){
+    .modifiers = modifiers_flag,
+    .key = key_sym,
+  };
+
+  if(!config_parse_keybind_action(k, action, args, arg_count)) {
     free(k);
     return false;
   }
@@ -466,315 +495,548 @@ config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
   return true;
 }
 
+void *
+config_arena_alloc(struct config_arena *arena, size_t size) {
+  struct config_arena_block *block = arena->blocks;
+  /* keeps the arrays of args aligned */
+  size_t start = block == NULL ? 0 : (block->used + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+  if(block == NULL || start + size > block->cap) {
+    size_t cap = max(size, CONFIG_ARENA_BLOCK_SIZE);
+    block = malloc(sizeof(*block) + cap);
+    block->cap = cap;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    start = 0;
+  }
+
+  block->used = start + size;
+  return block->data + start;
+}
+
+void
+config_arena_finish(struct config_arena *arena) {
+  struct config_arena_block *block = arena->blocks;
+  while(block != NULL) {
+    struct config_arena_block *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->blocks = NULL;
+}
+
+/* keywords are placed at config_keyword_hash() of their name, which has no collisions
+ * for the current ones. when adding a keyword put it in its slot, and if that is taken
+ * change the multipliers until all of them fit again */
+const struct config_keyword_entry config_keywords[CONFIG_KEYWORD_SLOTS] = {
+  [0] = { "keymap", CONFIG_KEYWORD_KEYMAP },
+  [1] = { "border_width", CONFIG_KEYWORD_BORDER_WIDTH },
+  [3] = { "border_radius_location", CONFIG_KEYWORD_BORDER_RADIUS_LOCATION },
+  [5] = { "tap_to_click", CONFIG_KEYWORD_TAP_TO_CLICK },
+  [9] = { "blur_brightness", CONFIG_KEYWORD_BLUR_BRIGHTNESS },
+  [10] = { "animation_curve", CONFIG_KEYWORD_ANIMATION_CURVE },
+  [13] = { "natural_scroll", CONFIG_KEYWORD_NATURAL_SCROLL },
+  [14] = { "inactive_opacity", CONFIG_KEYWORD_INACTIVE_OPACITY },
+  [18] = { "shadows_blur", CONFIG_KEYWORD_SHADOWS_BLUR },
+  [22] = { "pointer", CONFIG_KEYWORD_POINTER },
+  [23] = { "run", CONFIG_KEYWORD_RUN },
+  [24] = { "outer_gaps", CONFIG_KEYWORD_OUTER_GAPS },
+  [31] = { "cursor_size", CONFIG_KEYWORD_CURSOR_SIZE },
+  [32] = { "cursor_theme", CONFIG_KEYWORD_CURSOR_THEME },
+  [37] = { "shadows", CONFIG_KEYWORD_SHADOWS },
+  [38] = { "shadows_color", CONFIG_KEYWORD_SHADOWS_COLOR },
+  [39] = { "pointer_sensitivity", CONFIG_KEYWORD_POINTER_SENSITIVITY },
+  [41] = { "pointer_left_handed", CONFIG_KEYWORD_POINTER_LEFT_HANDED },
+  [43] = { "active_border_color", CONFIG_KEYWORD_ACTIVE_BORDER_COLOR },
+  [49] = { "layer_rule", CONFIG_KEYWORD_LAYER_RULE },
+  [51] = { "blur", CONFIG_KEYWORD_BLUR },
+  [52] = { "keymap_options", CONFIG_KEYWORD_KEYMAP_OPTIONS },
+  [54] = { "trackpad_scroll_method", CONFIG_KEYWORD_TRACKPAD_SCROLL_METHOD },
+  [59] = { "trackpad_tap_to_click", CONFIG_KEYWORD_TRACKPAD_TAP_TO_CLICK },
+  [64] = { "blur_passes", CONFIG_KEYWORD_BLUR_PASSES },
+  [65] = { "keybind", CONFIG_KEYWORD_KEYBIND },
+  [66] = { "blur_radius", CONFIG_KEYWORD_BLUR_RADIUS },
+  [67] = { "env", CONFIG_KEYWORD_ENV },
+  [68] = { "shadows_size", CONFIG_KEYWORD_SHADOWS_SIZE },
+  [70] = { "master_ratio", CONFIG_KEYWORD_MASTER_RATIO },
+  [71] = { "shadows_position", CONFIG_KEYWORD_SHADOWS_POSITION },
+  [76] = { "workspace", CONFIG_KEYWORD_WORKSPACE },
+  [77] = { "keyboard_delay", CONFIG_KEYWORD_KEYBOARD_DELAY },
+  [78] = { "trackpad_disable_while_typing", CONFIG_KEYWORD_TRACKPAD_DISABLE_WHILE_TYPING },
+  [79] = { "keyboard_rate", CONFIG_KEYWORD_KEYBOARD_RATE },
+  [80] = { "client_side_decorations", CONFIG_KEYWORD_CLIENT_SIDE_DECORATIONS },
+  [84] = { "placeholder_color", CONFIG_KEYWORD_PLACEHOLDER_COLOR },
+  [86] = { "blur_noise", CONFIG_KEYWORD_BLUR_NOISE },
+  [87] = { "border_radius", CONFIG_KEYWORD_BORDER_RADIUS },
+  [88] = { "inactive_border_color", CONFIG_KEYWORD_INACTIVE_BORDER_COLOR },
+  [95] = { "output", CONFIG_KEYWORD_OUTPUT },
+  [96] = { "apply_opacity_when_fullscreen", CONFIG_KEYWORD_APPLY_OPACITY_WHEN_FULLSCREEN },
+  [100] = { "master_count", CONFIG_KEYWORD_MASTER_COUNT },
+  [108] = { "animation_duration", CONFIG_KEYWORD_ANIMATION_DURATION },
+  [109] = { "blur_contrast", CONFIG_KEYWORD_BLUR_CONTRAST },
+  [110] = { "active_opacity", CONFIG_KEYWORD_ACTIVE_OPACITY },
+  [114] = { "inner_gaps", CONFIG_KEYWORD_INNER_GAPS },
+  [116] = { "min_toplevel_size", CONFIG_KEYWORD_MIN_TOPLEVEL_SIZE },
+  [118] = { "blur_saturation", CONFIG_KEYWORD_BLUR_SATURATION },
+  [119] = { "pointer_acceleration", CONFIG_KEYWORD_POINTER_ACCELERATION },
+  [120] = { "window_rule", CONFIG_KEYWORD_WINDOW_RULE },
+  [124] = { "trackpad_natural_scroll", CONFIG_KEYWORD_TRACKPAD_NATURAL_SCROLL },
+  [127] = { "animations", CONFIG_KEYWORD_ANIMATIONS },
+};
+
+uint32_t
+config_keyword_hash(const char *name, size_t len) {
+  return (len * 20 + (uint8_t)name[0] * 49 + (uint8_t)name[len - 1] * 6
+          + (uint8_t)name[len / 2]) % CONFIG_KEYWORD_SLOTS;
+}
+
+/* the table is written by hand, so make sure it still agrees with the hash. this is
+ * only an assert, so release builds skip it */
 void
-config_free_args(char **args, size_t arg_count) {
-  for(size_t i = 0; i < arg_count; i++) {
-    if(args[i] != NULL) free(args[i]);
+config_keywords_check(void) {
+  bool seen[CONFIG_KEYWORD_COUNT] = {0};
+
+  for(uint32_t i = 0; i < CONFIG_KEYWORD_SLOTS; i++) {
+    const struct config_keyword_entry *entry = &config_keywords[i];
+    if(entry->name == NULL) continue;
+
+    assert(config_keyword_hash(entry->name, strlen(entry->name)) == i
+           && "keyword is not in the slot of its hash");
+    assert(entry->keyword > CONFIG_KEYWORD_NONE && entry->keyword < CONFIG_KEYWORD_COUNT);
+    assert(!seen[entry->keyword] && "keyword is in the table twice");
+    seen[entry->keyword] = true;
+  }
+
+  for(uint32_t k = CONFIG_KEYWORD_NONE + 1; k < CONFIG_KEYWORD_COUNT; k++) {
+    assert(seen[k] && "keyword is missing from the table");
+  }
+}
+
+enum config_keyword
+config_keyword_from_name(const char *name) {
+  size_t len = strlen(name);
+  if(len == 0) return CONFIG_KEYWORD_NONE;
+
+  const struct config_keyword_entry *entry = &config_keywords[config_keyword_hash(name, len)];
+  if(entry->name == NULL || strcmp(entry->name, name) != 0) {
+    return CONFIG_KEYWORD_NONE;
   }
 
-  free(args);
+  return entry->keyword;
 }
 
 bool
 config_handle_value(struct mwc_config *c, char *keyword, char **args, size_t arg_count) {
-  if(strcmp(keyword, "min_toplevel_size") == 0) {
-    if(arg_count < 1) goto invalid;
+  switch(config_keyword_from_name(keyword)) {
+    case CONFIG_KEYWORD_MIN_TOPLEVEL_SIZE: {
+      if(arg_count < 1) goto invalid;
 
-    c->min_toplevel_size = clamp(atoi(args[0]), 0, INT_MAX);
-  } else if(strcmp(keyword, "keyboard_rate") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->min_toplevel_size = clamp(atoi(args[0]), 0, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_KEYBOARD_RATE: {
+      if(arg_count < 1) goto invalid;
 
-    c->keyboard_rate = clamp(atoi(args[0]), 0, INT_MAX);
-  } else if(strcmp(keyword, "keyboard_delay") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->keyboard_rate = clamp(atoi(args[0]), 0, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_KEYBOARD_DELAY: {
+      if(arg_count < 1) goto invalid;
 
-    c->keyboard_delay = clamp(atoi(args[0]), 0, INT_MAX);
-  } else if(strcmp(keyword, "pointer_sensitivity") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->keyboard_delay = clamp(atoi(args[0]), 0, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_POINTER_SENSITIVITY: {
+      if(arg_count < 1) goto invalid;
 
-    c->pointer_sensitivity = clamp(atof(args[0]), -1.0, 1.0);
-  } else if(strcmp(keyword, "pointer_acceleration") == 0) {
-    if(arg_count < 1) {
-      wlr_log(WLR_ERROR, "invalid args to %s", keyword);
-      config_free_args(args, arg_count);
-      return false;
+      c->pointer_sensitivity = clamp(atof(args[0]), -1.0, 1.0);
+      break;
     }
-    c->pointer_acceleration = atoi(args[0])
-      ? LIBINPUT_CONFIG_ACCEL_PROFILE_ADAPTIVE
-      : LIBINPUT_CONFIG_ACCEL_PROFILE_FLAT;
-  } else if(strcmp(keyword, "pointer") == 0) {
-    if(arg_count < 3) goto invalid;
-
-    enum libinput_config_accel_profile accel = atoi(args[1])
-      ? LIBINPUT_CONFIG_ACCEL_PROFILE_ADAPTIVE
-      : LIBINPUT_CONFIG_ACCEL_PROFILE_FLAT;
-
-    struct pointer_config *p = calloc(1, sizeof(*p));
-    *p = (struct pointer_config){
-      .name = strdup(args[0]),
-      .acceleration = accel,
-      .sensitivity = clamp(atof(args[2]), -1.0, 1.0),
-    };
-
-    wl_list_insert(&c->pointers, &p->link);
-  } else if(strcmp(keyword, "pointer_left_handed") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->pointer_left_handed = atoi(args[0]);
-  } else if(strcmp(keyword, "trackpad_disable_while_typing") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->trackpad_disable_while_typing = atoi(args[0]);
-  } else if(strcmp(keyword, "natural_scroll") == 0 // for backwards compatibility
-            || strcmp(keyword, "trackpad_natural_scroll") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->trackpad_natural_scroll = atoi(args[0]);
-  } else if(strcmp(keyword, "tap_to_click") == 0 // for backwards compatibility
-            || strcmp(keyword, "trackpad_tap_to_click") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->trackpad_tap_to_click = atoi(args[0]);
-  } else if(strcmp(keyword, "trackpad_scroll_method") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    if(strcmp(args[0], "no_scroll") == 0) {
-      c->trackpad_scroll_method = LIBINPUT_CONFIG_SCROLL_NO_SCROLL;
-    } else if(strcmp(args[0], "two_fingers") == 0) {
-      c->trackpad_scroll_method = LIBINPUT_CONFIG_SCROLL_2FG;
-    } else if(strcmp(args[0], "edge") == 0) {
-      c->trackpad_scroll_method = LIBINPUT_CONFIG_SCROLL_EDGE;
-    } else if(strcmp(args[0], "on_button_down") == 0) {
-      c->trackpad_scroll_method = LIBINPUT_CONFIG_SCROLL_ON_BUTTON_DOWN;
-    } else {
-      goto invalid;
+    case CONFIG_KEYWORD_POINTER_ACCELERATION: {
+      if(arg_count < 1) goto invalid;
+
+      c->pointer_acceleration = atoi(args[0])
+        ? LIBINPUT_CONFIG_ACCEL_PROFILE_ADAPTIVE
+        : LIBINPUT_CONFIG_ACCEL_PROFILE_FLAT;
+      break;
     }
-  } else if(strcmp(keyword, "border_width") == 0) {
-    if(arg_count < 1) goto invalid;
+    case CONFIG_KEYWORD_POINTER: {
+      if(arg_count < 3) goto invalid;
 
-    c->border_width = clamp(atoi(args[0]), 0, INT_MAX);
-  } else if(strcmp(keyword, "outer_gaps") == 0) {
-    if(arg_count < 1) goto invalid;
+      enum libinput_config_accel_profile accel = atoi(args[1])
+        ? LIBINPUT_CONFIG_ACCEL_PROFILE_ADAPTIVE
+        : LIBINPUT_CONFIG_ACCEL_PROFILE_FLAT;
 
-    c->outer_gaps = clamp(atoi(args[0]), 0, INT_MAX);
-  } else if(strcmp(keyword, "inner_gaps") == 0) {
-    if(arg_count < 1) goto invalid;
+      struct pointer_config *p = calloc(1, sizeof(*p));
+      *p = (struct pointer_config){
+        .name = strdup(args[0]),
+        .acceleration = accel,
+        .sensitivity = clamp(atof(args[2]), -1.0, 1.0),
+      };
 
-    c->inner_gaps = clamp(atoi(args[0]), 0, INT_MAX);
-  } else if(strcmp(keyword, "master_ratio") == 0) {
-    if(arg_count < 1) goto invalid;
+      wl_list_insert(&c->pointers, &p->link);
+      break;
+    }
+    case CONFIG_KEYWORD_POINTER_LEFT_HANDED: {
+      if(arg_count < 1) goto invalid;
 
-    c->master_ratio = clamp(atof(args[0]), 0, 1);
-  } else if(strcmp(keyword, "master_count") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->pointer_left_handed = atoi(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_TRACKPAD_DISABLE_WHILE_TYPING: {
+      if(arg_count < 1) goto invalid;
 
-    c->master_count = clamp(atoi(args[0]), 1, INT_MAX);
-  } else if(strcmp(keyword, "cursor_theme") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->trackpad_disable_while_typing = atoi(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_NATURAL_SCROLL: // for backwards compatibility
+    case CONFIG_KEYWORD_TRACKPAD_NATURAL_SCROLL: {
+      if(arg_count < 1) goto invalid;
 
-    c->cursor_theme = strdup(args[0]);
-  } else if(strcmp(keyword, "cursor_size") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->trackpad_natural_scroll = atoi(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_TAP_TO_CLICK: // for backwards compatibility
+    case CONFIG_KEYWORD_TRACKPAD_TAP_TO_CLICK: {
+      if(arg_count < 1) goto invalid;
 
-    c->cursor_size = clamp(atoi(args[0]), 0, INT_MAX);
-  } else if(strcmp(keyword, "inactive_border_color") == 0) {
-    if(!parse_color_rgba_or_hex(args, arg_count, c->inactive_border_color)) {
-      goto invalid;
+      c->trackpad_tap_to_click = atoi(args[0]);
+      break;
     }
-  } else if(strcmp(keyword, "active_border_color") == 0) {
-    if(!parse_color_rgba_or_hex(args, arg_count, c->active_border_color)) {
-      goto invalid;
+    case CONFIG_KEYWORD_TRACKPAD_SCROLL_METHOD: {
+      if(arg_count < 1) goto invalid;
+
+      if(strcmp(args[0], "no_scroll") == 0) {
+        c->trackpad_scroll_method = LIBINPUT_CONFIG_SCROLL_NO_SCROLL;
+      } else if(strcmp(args[0], "two_fingers") == 0) {
+        c->trackpad_scroll_method = LIBINPUT_CONFIG_SCROLL_2FG;
+      } else if(strcmp(args[0], "edge") == 0) {
+        c->trackpad_scroll_method = LIBINPUT_CONFIG_SCROLL_EDGE;
+      } else if(strcmp(args[0], "on_button_down") == 0) {
+        c->trackpad_scroll_method = LIBINPUT_CONFIG_SCROLL_ON_BUTTON_DOWN;
+      } else {
+        goto invalid;
+      }
+      break;
     }
-  } else if(strcmp(keyword, "output") == 0) {
-    if(arg_count < 6) goto invalid;
-
-    struct output_config *m = calloc(1, sizeof(*m));
-    *m = (struct output_config){
-      .name = strdup(args[0]),
-      .x = atoi(args[1]),
-      .y = atoi(args[2]),
-      .width = atoi(args[3]),
-      .height = atoi(args[4]),
-      .refresh_rate = atoi(args[5]) * 1000,
-      /* scale is optional, defaults to 1 */
-      .scale = arg_count > 6 ? atof(args[6]) : 1,
-    };
-
-    wl_list_insert(&c->outputs, &m->link);
-  } else if(strcmp(keyword, "workspace") == 0) {
-    if(arg_count < 2) goto invalid;
-
-    struct workspace_config *w = calloc(1, sizeof(*w));
-    *w = (struct workspace_config){
-      .index = atoi(args[0]),
-      .output = strdup(args[1]),
-    };
-
-    wl_list_insert(&c->workspaces, &w->link);
-  } else if(strcmp(keyword, "run") == 0) {
-    if(arg_count < 1) goto invalid;
-      
-    if(c->run_count > 64) {
-      wlr_log(WLR_ERROR, "do you really need 65 runs?");
-      return false;
+    case CONFIG_KEYWORD_BORDER_WIDTH: {
+      if(arg_count < 1) goto invalid;
+
+      c->border_width = clamp(atoi(args[0]), 0, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_OUTER_GAPS: {
+      if(arg_count < 1) goto invalid;
+
+      c->outer_gaps = clamp(atoi(args[0]), 0, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_INNER_GAPS: {
+      if(arg_count < 1) goto invalid;
+
+      c->inner_gaps = clamp(atoi(args[0]), 0, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_MASTER_RATIO: {
+      if(arg_count < 1) goto invalid;
+
+      c->master_ratio = clamp(atof(args[0]), 0, 1);
+      break;
+    }
+    case CONFIG_KEYWORD_MASTER_COUNT: {
+      if(arg_count < 1) goto invalid;
+
+      c->master_count = clamp(atoi(args[0]), 1, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_CURSOR_THEME: {
+      if(arg_count < 1) goto invalid;
+
+      c->cursor_theme = strdup(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_CURSOR_SIZE: {
+      if(arg_count < 1) goto invalid;
+
+      c->cursor_size = clamp(atoi(args[0]), 0, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_INACTIVE_BORDER_COLOR: {
+      if(!parse_color_rgba_or_hex(args, arg_count, c->inactive_border_color)) {
+        goto invalid;
+      }
+      break;
+    }
+    case CONFIG_KEYWORD_ACTIVE_BORDER_COLOR: {
+      if(!parse_color_rgba_or_hex(args, arg_count, c->active_border_color)) {
+        goto invalid;
+      }
+      break;
+    }
+    case CONFIG_KEYWORD_OUTPUT: {
+      if(arg_count < 6) goto invalid;
+
+      struct output_config *m = calloc(1, sizeof(*m));
+      *m = (struct output_config){
+        .name = strdup(args[0]),
+        .x = atoi(args[1]),
+        .y = atoi(args[2]),
+        .width = atoi(args[3]),
+        .height = atoi(args[4]),
+        .refresh_rate = atoi(args[5]) * 1000,
+        /* scale is optional, defaults to 1 */
+        .scale = arg_count > 6 ? atof(args[6]) : 1,
+      };
+
+      wl_list_insert(&c->outputs, &m->link);
+      break;
+    }
+    case CONFIG_KEYWORD_WORKSPACE: {
+      if(arg_count < 2) goto invalid;
+
+      const struct mwc_layout *layout = NULL;
+      if(arg_count > 2) {
+        layout = layout_from_name(args[2]);
+        if(layout == NULL) {
+          wlr_log(WLR_ERROR, "there is no layout %s", args[2]);
+          goto invalid;
+        }
+      }
+
+      struct workspace_config *w = calloc(1, sizeof(*w));
+      *w = (struct workspace_config){
+        .index = atoi(args[0]),
+        .output = strdup(args[1]),
+        .layout = layout,
+      };
+
+      wl_list_insert(&c->workspaces, &w->link);
+      break;
+    }
+    case CONFIG_KEYWORD_RUN: {
+      if(arg_count < 1) goto invalid;
+
+      if(c->run_count >= 64) {
+        wlr_log(WLR_ERROR, "do you really need 65 runs?");
+        return false;
+      }
+      c->run[c->run_count] = strdup(args[0]);
+      c->run_count++;
+      break;
+    }
+    case CONFIG_KEYWORD_KEYBIND: {
+      if(arg_count < 3) goto invalid;
+
+      if(!config_add_keybind(c, args[0], args[1], args[2], &args[3], arg_count - 3)) {
+        goto invalid;
+      }
+      break;
+    }
+    case CONFIG_KEYWORD_ENV: {
+      if(arg_count < 2) goto invalid;
+
+      struct env_config *e = calloc(1, sizeof(*e));
+      e->name = strdup(args[0]);
+      e->value = strdup(args[1]);
+      wl_list_insert(c->env.prev, &e->link);
+      break;
+    }
+    case CONFIG_KEYWORD_WINDOW_RULE: {
+      if(arg_count < 3) goto invalid;
+
+      if(!config_add_window_rule(c, args[0], args[1], args[2], &args[3], arg_count - 3)) {
+        goto invalid;
+      }
+      break;
+    }
+    case CONFIG_KEYWORD_ANIMATIONS: {
+      if(arg_count < 1) goto invalid;
+
+      c->animations = atoi(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_ANIMATION_DURATION: {
+      if(arg_count < 1) goto invalid;
+
+      c->animation_duration = clamp(atoi(args[0]), 0, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_ANIMATION_CURVE: {
+      if(arg_count < 4) goto invalid;
+
+      c->animation_curve.control_points[0] = atof(args[0]);
+      c->animation_curve.control_points[1] = atof(args[1]);
+      c->animation_curve.control_points[2] = atof(args[2]);
+      c->animation_curve.control_points[3] = atof(args[3]);
+      break;
+    }
+    case CONFIG_KEYWORD_PLACEHOLDER_COLOR: {
+      /* not an error, so it does not stop the rest of the config from reloading */
+      wlr_log(WLR_ERROR, "placeholder_color has been depricated, and should not be used anymore");
+      break;
+    }
+    case CONFIG_KEYWORD_CLIENT_SIDE_DECORATIONS: {
+      if(arg_count < 1) goto invalid;
+
+      c->client_side_decorations = atoi(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_INACTIVE_OPACITY: {
+      if(arg_count < 1) goto invalid;
+
+      c->inactive_opacity = clamp(atof(args[0]), 0.0, 1.0);
+      break;
+    }
+    case CONFIG_KEYWORD_ACTIVE_OPACITY: {
+      if(arg_count < 1) goto invalid;
+
+      c->active_opacity = clamp(atof(args[0]), 0.0, 1.0);
+      break;
+    }
+    case CONFIG_KEYWORD_APPLY_OPACITY_WHEN_FULLSCREEN: {
+      if(arg_count < 1) goto invalid;
+
+      c->apply_opacity_when_fullscreen = atoi(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_KEYMAP: {
+      if(arg_count < 2) goto invalid;
+      /* handle appending to this string */
+      config_add_keymap(c, args[0], args[1]);
+      break;
+    }
+    case CONFIG_KEYWORD_KEYMAP_OPTIONS: {
+      if(arg_count < 1) goto invalid;
+
+      c->keymap_options = strdup(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_BORDER_RADIUS: {
+      if(arg_count < 1) goto invalid;
+
+      /* we clamp it between 1 and INT_MAX so it works with current scenefx (see #75 on scenefx)*/
+      c->border_radius = clamp(atoi(args[0]), 1, INT_MAX);
+      break;
     }
-    c->run[c->run_count] = strdup(args[0]);
-    c->run_count++;
-  } else if(strcmp(keyword, "keybind") == 0) {
-    if(arg_count < 3) goto invalid;
-
-    config_add_keybind(c, args[0], args[1], args[2], &args[3], arg_count - 3);
-  } else if(strcmp(keyword, "env") == 0) {
-    if(arg_count < 2) goto invalid;
-
-    setenv(args[0], args[1], true);
-  } else if(strcmp(keyword, "window_rule") == 0) {
-    if(arg_count < 3) goto invalid;
-
-    config_add_window_rule(c, args[0], args[1], args[2], &args[3], arg_count - 3);
-  } else if(strcmp(keyword, "animations") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->animations = atoi(args[0]);
-  } else if(strcmp(keyword, "animation_duration") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->animation_duration = clamp(atoi(args[0]), 0, INT_MAX);
-  } else if(strcmp(keyword, "animation_curve") == 0) {
-    if(arg_count < 4) goto invalid;
-
-    c->animation_curve[0] = atof(args[0]);
-    c->animation_curve[1] = atof(args[1]);
-    c->animation_curve[2] = atof(args[2]);
-    c->animation_curve[3] = atof(args[3]);
-    bake_bezier_curve_points(c);
-  } else if(strcmp(keyword, "placeholder_color") == 0) {
-    wlr_log(WLR_ERROR, "placeholder_color has been depricated, and should not be used anymore");
-    goto depricated;
-  } else if(strcmp(keyword, "client_side_decorations") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->client_side_decorations = atoi(args[0]);
-  } else if(strcmp(keyword, "inactive_opacity") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->inactive_opacity = clamp(atof(args[0]), 0.0, 1.0);
-  } else if(strcmp(keyword, "active_opacity") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->active_opacity = clamp(atof(args[0]), 0.0, 1.0);
-  } else if(strcmp(keyword, "apply_opacity_when_fullscreen") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->apply_opacity_when_fullscreen = atoi(args[0]);
-  } else if(strcmp(keyword, "keymap") == 0) {
-    if(arg_count < 2) goto invalid;
-    /* handle appending to this string */
-    config_add_keymap(c, args[0], args[1]);
-  } else if(strcmp(keyword, "keymap_options") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    c->keymap_options = strdup(args[0]);
-  } else if(strcmp(keyword, "border_radius") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    /* we clamp it between 1 and INT_MAX so it works with current scenefx (see #75 on scenefx)*/
-    c->border_radius = clamp(atoi(args[0]), 1, INT_MAX);
-  } else if(strcmp(keyword, "border_radius_location") == 0) {
-    if(arg_count < 1) goto invalid;
-
-    if(strcmp(args[0], "all") == 0) {
-      c->border_radius_location = CORNER_LOCATION_ALL;
-    } else {
-      for(size_t i = 0; i < arg_count; i++) {
-        if(strcmp(args[i], "top") == 0) {
-          c->border_radius_location |= CORNER_LOCATION_TOP;
-        } else if(strcmp(args[i], "bottom") == 0) {
-          c->border_radius_location |= CORNER_LOCATION_BOTTOM;
-        } else if(strcmp(args[i], "right") == 0) {
-          c->border_radius_location |= CORNER_LOCATION_RIGHT;
-        } else if(strcmp(args[i], "left") == 0) {
-          c->border_radius_location |= CORNER_LOCATION_LEFT;
-        } else if(strcmp(args[i], "top_right") == 0) {
-          c->border_radius_location |= CORNER_LOCATION_TOP_RIGHT;
-        } else if(strcmp(args[i], "bottom_right") == 0) {
-          c->border_radius_location |= CORNER_LOCATION_BOTTOM_RIGHT;
-        } else if(strcmp(args[i], "bottom_left") == 0) {
-          c->border_radius_location |= CORNER_LOCATION_BOTTOM_LEFT;
-        } else if(strcmp(args[i], "top_left") == 0) {
-          c->border_radius_location |= CORNER_LOCATION_TOP_LEFT;
+    case CONFIG_KEYWORD_BORDER_RADIUS_LOCATION: {
+      if(arg_count < 1) goto invalid;
+
+      if(strcmp(args[0], "all") == 0) {
+        c->border_radius_location = CORNER_LOCATION_ALL;
+      } else {
+        for(size_t i = 0; i < arg_count; i++) {
+          if(strcmp(args[i], "top") == 0) {
+            c->border_radius_location |= CORNER_LOCATION_TOP;
+          } else if(strcmp(args[i], "bottom") == 0) {
+            c->border_radius_location |= CORNER_LOCATION_BOTTOM;
+          } else if(strcmp(args[i], "right") == 0) {
+            c->border_radius_location |= CORNER_LOCATION_RIGHT;
+          } else if(strcmp(args[i], "left") == 0) {
+            c->border_radius_location |= CORNER_LOCATION_LEFT;
+          } else if(strcmp(args[i], "top_right") == 0) {
+            c->border_radius_location |= CORNER_LOCATION_TOP_RIGHT;
+          } else if(strcmp(args[i], "bottom_right") == 0) {
+            c->border_radius_location |= CORNER_LOCATION_BOTTOM_RIGHT;
+          } else if(strcmp(args[i], "bottom_left") == 0) {
+            c->border_radius_location |= CORNER_LOCATION_BOTTOM_LEFT;
+          } else if(strcmp(args[i], "top_left") == 0) {
+            c->border_radius_location |= CORNER_LOCATION_TOP_LEFT;
+          }
         }
       }
+      break;
     }
-  } else if(strcmp(keyword, "blur") == 0) {
-    if(arg_count < 1) goto invalid;
+    case CONFIG_KEYWORD_BLUR: {
+      if(arg_count < 1) goto invalid;
 
-    c->blur = atoi(args[0]);
-  } else if(strcmp(keyword, "blur_passes") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->blur = atoi(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_BLUR_PASSES: {
+      if(arg_count < 1) goto invalid;
 
-    c->blur_params.num_passes = clamp(atoi(args[0]), 1, INT_MAX);
-  } else if(strcmp(keyword, "blur_radius") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->blur_params.num_passes = clamp(atoi(args[0]), 1, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_BLUR_RADIUS: {
+      if(arg_count < 1) goto invalid;
 
-    c->blur_params.radius = clamp(atoi(args[0]), 0, INT_MAX);
-  } else if(strcmp(keyword, "blur_noise") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->blur_params.radius = clamp(atoi(args[0]), 0, INT_MAX);
+      break;
+    }
+    case CONFIG_KEYWORD_BLUR_NOISE: {
+      if(arg_count < 1) goto invalid;
 
-    c->blur_params.noise = max(atof(args[0]), 0.0);
-  } else if(strcmp(keyword, "blur_brightness") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->blur_params.noise = max(atof(args[0]), 0.0);
+      break;
+    }
+    case CONFIG_KEYWORD_BLUR_BRIGHTNESS: {
+      if(arg_count < 1) goto invalid;
 
-    c->blur_params.brightness = max(atof(args[0]), 0.0);
-  } else if(strcmp(keyword, "blur_contrast") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->blur_params.brightness = max(atof(args[0]), 0.0);
+      break;
+    }
+    case CONFIG_KEYWORD_BLUR_CONTRAST: {
+      if(arg_count < 1) goto invalid;
 
-    c->blur_params.contrast = max(atof(args[0]), 0.0);
-  } else if(strcmp(keyword, "blur_saturation") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->blur_params.contrast = max(atof(args[0]), 0.0);
+      break;
+    }
+    case CONFIG_KEYWORD_BLUR_SATURATION: {
+      if(arg_count < 1) goto invalid;
 
-    c->blur_params.saturation = max(atof(args[0]), 0.0);
-  } else if(strcmp(keyword, "shadows") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->blur_params.saturation = max(atof(args[0]), 0.0);
+      break;
+    }
+    case CONFIG_KEYWORD_SHADOWS: {
+      if(arg_count < 1) goto invalid;
 
-    c->shadows = atoi(args[0]);
-  } else if(strcmp(keyword, "shadows_size") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->shadows = atoi(args[0]);
+      break;
+    }
+    case CONFIG_KEYWORD_SHADOWS_SIZE: {
+      if(arg_count < 1) goto invalid;
 
-    c->shadows_size = max(atoi(args[0]), 0);
-  } else if(strcmp(keyword, "shadows_blur") == 0) {
-    if(arg_count < 1) goto invalid;
+      c->shadows_size = max(atoi(args[0]), 0);
+      break;
+    }
+    case CONFIG_KEYWORD_SHADOWS_BLUR: {
+      if(arg_count < 1) goto invalid;
 
-    c->shadows_blur = max(atof(args[0]), 0.0);
-  } else if(strcmp(keyword, "shadows_position") == 0) {
-    if(arg_count < 2) goto invalid;
+      c->shadows_blur = max(atof(args[0]), 0.0);
+      break;
+    }
+    case CONFIG_KEYWORD_SHADOWS_POSITION: {
+      if(arg_count < 2) goto invalid;
 
-    c->shadows_position.x = atoi(args[0]);
-    c->shadows_position.y = atoi(args[1]);
-  } else if(strcmp(keyword, "shadows_color") == 0) {
-    if(!parse_color_rgba_or_hex(args, arg_count, c->shadows_color)) {
-      goto invalid;
+      c->shadows_position.x = atoi(args[0]);
+      c->shadows_position.y = atoi(args[1]);
+      break;
+    }
+    case CONFIG_KEYWORD_SHADOWS_COLOR: {
+      if(!parse_color_rgba_or_hex(args, arg_count, c->shadows_color)) {
+        goto invalid;
+      }
+      break;
+    }
+    case CONFIG_KEYWORD_LAYER_RULE: {
+      if(arg_count < 2) goto invalid;
+
+      if(!config_add_layer_rule(c, args[0], args[1], &args[2], arg_count - 2)) {
+        goto invalid;
+      }
+      break;
+    }
+    default: {
+      wlr_log(WLR_ERROR, "invalid keyword %s", keyword);
+      return false;
     }
-  } else if(strcmp(keyword, "layer_rule") == 0) {
-    if(arg_count < 2) goto invalid;
-    
-    config_add_layer_rule(c, args[0], args[1], &args[2], arg_count - 2);
-  } else {
-    wlr_log(WLR_ERROR, "invalid keyword %s", keyword);
-    free(keyword);
-    config_free_args(args, arg_count);
-    return false;
   }
 
-  free(keyword);
-  config_free_args(args, arg_count);
   return true;
 
 invalid: 
   wlr_log(WLR_ERROR, "invalid args to %s", keyword);
-depricated:
-  free(keyword);
-  config_free_args(args, arg_count);
   return false;
 }
 
@@ -816,101 +1078,63 @@ get_config_path(char *dest, size_t size) {
   return false;
 }
 
-/* assumes the line is newline teriminated, as it should be with fgets() */
 bool
-config_handle_line(char *line, size_t line_number, char **keyword,
-                   char ***args, size_t *args_count) {
-  char *p = line;
+config_handle_line(struct config_arena *arena, const char *line, const char *end,
+                   size_t line_number, char **keyword, char ***args, size_t *args_count) {
+  const char *p = line;
 
   /* skip whitespace */
-  while(*p == ' ' || *p == '\t') p++;
+  while(p < end && (*p == ' ' || *p == '\t')) p++;
 
   /* if its an empty line or it starts with '#' (comment) skip */
-  if(*p == '\n' || *p == '#') {
+  if(p == end || *p == '#') {
     return false; 
   }
 
-  size_t len = 0, cap = STRING_INITIAL_LENGTH;
-  char *kw = calloc(cap, sizeof(char));
-  size_t ars_len = 0, ars_cap = 8;
-  char **ars = calloc(ars_cap, sizeof(*args));
+  /* a token always takes up at least one more byte of the line than it has
+   * characters, apart from the last one which needs one for its terminator.
+   * tokens are seperated by whitespace, so there are at most half as many */
+  char *q = config_arena_alloc(arena, end - p + 1);
+  char **ars = config_arena_alloc(arena, ((end - p) / 2 + 1) * sizeof(*ars));
+  size_t ars_len = 0;
 
-  char *q = kw;
-  while(*p != ' ' && *p != '\t' && *p != '\n') {
-    if(len >= cap) {
-      cap *= 2;
-      keyword = realloc(keyword, cap);
-      q = &kw[len];
-    }
-    *q = *p;
-    p++;
-    q++;
-    len++;
+  char *kw = q;
+  while(p < end && *p != ' ' && *p != '\t') {
+    *q++ = *p++;
   }
-
-  if(len >= cap) {
-    cap += 1;
-    keyword = realloc(keyword, cap);
-    q = &kw[len];
-  }
-  *q = 0;
+  *q++ = 0;
 
   /* skip whitespace */
-  while(*p == ' ' || *p == '\t') p++;
+  while(p < end && (*p == ' ' || *p == '\t')) p++;
 
-  if(*p == '\n') {
+  if(p == end) {
     wlr_log(WLR_ERROR, "config: line %zu: no args provided for %s", line_number, kw);
     return false;
   }
 
-  while(*p != '\n') {
-    if(ars_len >= ars_cap) {
-      ars_cap *= 2;
-      ars = realloc(ars, ars_cap * sizeof(*ars));
-    }
-
-    len = 0;
-    cap = STRING_INITIAL_LENGTH;
-    ars[ars_len] = calloc(cap, sizeof(char));
+  while(p < end) {
+    ars[ars_len] = q;
 
-    q = ars[ars_len];
     bool word = false;
     if(*p == '\"') {
       word = true;
       p++;
-    };
-
-    while((word && *p != '\"' && *p != '\n')
-          || (!word && *p != ' ' && *p != '\t' && *p != '\n')) {
-      if(len >= cap) {
-        cap *= 2;
-        ars[ars_len] = realloc(ars[ars_len], cap);
-        q = &ars[ars_len][len];
-      }
-      if(word && *p == '\\' && *(p + 1) == '\"') {
-        *q = '\"';
-        p += 2;
-      } else if(word && *p == '\\' && *(p + 1) == '\\') {
-        *q = '\\';
+    }
+
+    while(p < end && ((word && *p != '\"') || (!word && *p != ' ' && *p != '\t'))) {
+      if(word && *p == '\\' && p + 1 < end && (p[1] == '\"' || p[1] == '\\')) {
+        *q++ = p[1];
         p += 2;
       } else {
-        *q = *p;
-        p++;
+        *q++ = *p++;
       }
-      q++;
-      len++;
     }
-    if(len >= cap) {
-      cap += 1;
-      ars[ars_len] = realloc(ars[ars_len], cap);
-      q = &ars[ars_len][len];
-    }
-    *q = 0;
+    *q++ = 0;
     ars_len++;
 
-    if(word) p++;
+    if(word && p < end) p++;
     /* skip whitespace */
-    while(*p == ' ' || *p == '\t') p++;
+    while(p < end && (*p == ' ' || *p == '\t')) p++;
   }
 
   *args_count = ars_len;
@@ -960,11 +1184,13 @@ config_set_default_needed_params(struct mwc_config *c) {
     wlr_log(WLR_INFO,
             "animation_duration not specified. using default %ud", c->animation_duration);
   }
-  if(c->animations && c->animation_curve[0] == 0 && c->animation_curve[1] == 0
-     && c->animation_curve[2] == 0 && c->animation_curve[3] == 0) {
-    bake_bezier_curve_points(c);
+  double *control_points = c->animation_curve.control_points;
+  if(c->animations && control_points[0] == 0 && control_points[1] == 0
+     && control_points[2] == 0 && control_points[3] == 0) {
     wlr_log(WLR_INFO, "animation_curve not specified. baking default linear");
   }
+  /* baked once here, as animation_curve might be specified multiple times */
+  bake_bezier_curve_points(&c->animation_curve);
   if(c->inactive_opacity == 0) {
     c->inactive_opacity = 1.0;
     wlr_log(WLR_INFO,
@@ -983,39 +1209,44 @@ config_set_default_needed_params(struct mwc_config *c) {
 
 extern struct mwc_server server;
 
-struct mwc_config *
-config_load() {
-  struct mwc_config *c = calloc(1, sizeof(*c));
-
-  FILE *config_file;
+/* the environment is only read here, once on the main thread before the parser
+ * thread is started, as config_apply() calls setenv() and glibc can realloc environ
+ * under a concurrent getenv() */
+void
+config_resolve_paths(void) {
   char path[1024];
   if(get_config_path(path, sizeof(path))) {
-    config_file = fopen(path, "r");
-    if(config_file != NULL) {
-      char *current = path;
-      char *last_slash = NULL;
-      while(*current != 0) {
-        if(*current == '/') {
-          last_slash = current;
-        }
-        current++;
-      }
+    server.config_path = strdup(path);
+  } else {
+    wlr_log(WLR_INFO, "couldn't get config file path, backing to default config");
+  }
 
+  get_default_config_path(path, sizeof(path));
+  path[sizeof(path) - 1] = 0;
+  server.default_config_path = strdup(path);
+}
+
+struct mwc_config *
+config_load(const char *path) {
+  struct mwc_config *c = calloc(1, sizeof(*c));
+
+  int config_fd = -1;
+  if(path != NULL) {
+    config_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(config_fd >= 0) {
+      char *last_slash = strrchr(path, '/');
       assert(last_slash != NULL);
-      *last_slash = 0;
-      c->dir = strdup(path);
+      c->dir = strndup(path, last_slash - path);
     } else {
       wlr_log(WLR_INFO, "couldn't open the config file");
-      get_default_config_path(path, sizeof(path));
-      config_file = fopen(path, "r");
     }
-  } else {
-    wlr_log(WLR_INFO, "couldn't get config file path, backing to default config");
-    get_default_config_path(path, sizeof(path));
-    config_file = fopen(path, "r");
   }
 
-  if(config_file == NULL) {
+  if(config_fd < 0) {
+    config_fd = open(server.default_config_path, O_RDONLY | O_CLOEXEC);
+  }
+
+  if(config_fd < 0) {
     wlr_log(WLR_ERROR, "couldn't open the default config file");
     free(c);
     return NULL;
@@ -1030,23 +1261,57 @@ config_load() {
   wl_list_init(&c->window_rules.size);
   wl_list_init(&c->window_rules.opacity);
   wl_list_init(&c->layer_rules.blur);
+  wl_list_init(&c->env);
+  window_rule_cache_init(&c->window_rule_cache);
+
+  struct stat st;
+  const char *data = NULL;
+  size_t size = 0;
+  if(fstat(config_fd, &st) == 0 && st.st_size > 0) {
+    size = st.st_size;
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, config_fd, 0);
+    if(data == MAP_FAILED) {
+      wlr_log(WLR_ERROR, "couldn't map the config file");
+      data = NULL;
+      size = 0;
+      c->error_count++;
+    }
+  }
+  close(config_fd);
 
-  /* you aint gonna have lines longer than 1kB */
-  char line_buffer[1024] = {0};
+  /* the whole file is tokenized in one go, and all the tokens are freed together */
+  struct config_arena arena = {0};
   char *keyword, **args;
   size_t args_count;
   size_t line_number = 1;
-  while(fgets(line_buffer, 1024, config_file) != NULL) {
-    bool valid = config_handle_line(line_buffer, line_number, &keyword, &args, &args_count);
-    if(valid) {
-      config_handle_value(c, keyword, args, args_count);
+  const char *line = data;
+  const char *end = data != NULL ? data + size : NULL;
+  while(line < end) {
+    const char *newline = memchr(line, '\n', end - line);
+    const char *line_end = newline != NULL ? newline : end;
+
+    bool valid = config_handle_line(&arena, line, line_end, line_number,
+                                    &keyword, &args, &args_count);
+    if(valid && !config_handle_value(c, keyword, args, args_count)) {
+      wlr_log(WLR_ERROR, "config: line %zu could not be applied", line_number);
+      c->error_count++;
     }
+
+    if(newline == NULL) break;
+    line = newline + 1;
     line_number++;
   }
 
-  fclose(config_file);
+  config_arena_finish(&arena);
+  if(data != NULL) {
+    munmap((void *)data, size);
+  }
+
   config_set_default_needed_params(c);
 
+  keybind_table_build(&c->keybind_table, &c->keybinds);
+  keybind_table_build(&c->pointer_keybind_table, &c->pointer_keybinds);
+
   return c;
 }
 
@@ -1072,43 +1337,32 @@ config_destroy(struct mwc_config *c) {
   wl_list_for_each_safe(k, k_temp, &c->pointer_keybinds, link) {
     free(k);
   }
+  keybind_table_finish(&c->keybind_table);
+  keybind_table_finish(&c->pointer_keybind_table);
 
   struct window_rule_float *wrf, *wrf_temp;
   wl_list_for_each_safe(wrf, wrf_temp, &c->window_rules.floating, link) {
-    if(wrf->condition.has_app_id_regex) {
-      regfree(&wrf->condition.app_id_regex);
-    }
-    if(wrf->condition.has_title_regex) {
-      regfree(&wrf->condition.title_regex);
-    }
+    window_rule_condition_finish(&wrf->condition);
     free(wrf);
   }
   struct window_rule_size *wrs, *wrs_temp;
   wl_list_for_each_safe(wrs, wrs_temp, &c->window_rules.size, link) {
-    if(wrs->condition.has_app_id_regex) {
-      regfree(&wrs->condition.app_id_regex);
-    }
-    if(wrs->condition.has_title_regex) {
-      regfree(&wrs->condition.title_regex);
-    }
+    window_rule_condition_finish(&wrs->condition);
     free(wrs);
   }
   struct window_rule_opacity *wro, *wro_temp;
   wl_list_for_each_safe(wro, wro_temp, &c->window_rules.opacity, link) {
-    if(wro->condition.has_app_id_regex) {
-      regfree(&wro->condition.app_id_regex);
-    }
-    if(wro->condition.has_title_regex) {
-      regfree(&wro->condition.title_regex);
-    }
+    window_rule_condition_finish(&wro->condition);
     free(wro);
   }
+  window_rule_cache_finish(&c->window_rule_cache);
 
   struct layer_rule_blur *lrb, *lrb_temp;
   wl_list_for_each_safe(lrb, lrb_temp, &c->layer_rules.blur, link) {
     if(lrb->condition.has) {
       regfree(&lrb->condition.regex);
     }
+    free(lrb->condition.source);
 
     free(lrb);
   }
@@ -1125,7 +1379,12 @@ config_destroy(struct mwc_config *c) {
 
   free(c->cursor_theme);
 
-  free(c->baked_points);
+  struct env_config *e, *e_temp;
+  wl_list_for_each_safe(e, e_temp, &c->env, link) {
+    free(e->name);
+    free(e->value);
+    free(e);
+  }
 
   for(size_t i = 0; i < c->run_count; i++) {
     free(c->run[i]);
@@ -1134,56 +1393,229 @@ config_destroy(struct mwc_config *c) {
   free(c);
 }
 
-void 
-toplevel_reapply_effects_etc(struct mwc_toplevel *toplevel) {
-  toplevel_recheck_opacity_rules(toplevel);
+bool
+config_outputs_equal(struct wl_list *a, struct wl_list *b) {
+  struct wl_list *i = a->next, *j = b->next;
+  for(; i != a && j != b; i = i->next, j = j->next) {
+    struct output_config *x = wl_container_of(i, x, link);
+    struct output_config *y = wl_container_of(j, y, link);
+    if(strcmp(x->name, y->name) != 0 || x->width != y->width || x->height != y->height
+       || x->refresh_rate != y->refresh_rate || x->x != y->x || x->y != y->y
+       || x->scale != y->scale) {
+      return false;
+    }
+  }
+  return i == a && j == b;
+}
 
-  if(toplevel->shadow != NULL) {
-    wlr_scene_node_destroy(&toplevel->shadow->node);
-    toplevel->shadow = NULL;
+bool
+config_pointers_equal(struct wl_list *a, struct wl_list *b) {
+  struct wl_list *i = a->next, *j = b->next;
+  for(; i != a && j != b; i = i->next, j = j->next) {
+    struct pointer_config *x = wl_container_of(i, x, link);
+    struct pointer_config *y = wl_container_of(j, y, link);
+    if(strcmp(x->name, y->name) != 0 || x->sensitivity != y->sensitivity
+       || x->acceleration != y->acceleration) {
+      return false;
+    }
+  }
+  return i == a && j == b;
+}
+
+bool
+config_opacity_rules_equal(struct wl_list *a, struct wl_list *b) {
+  struct wl_list *i = a->next, *j = b->next;
+  for(; i != a && j != b; i = i->next, j = j->next) {
+    struct window_rule_opacity *x = wl_container_of(i, x, link);
+    struct window_rule_opacity *y = wl_container_of(j, y, link);
+    if(!window_rule_conditions_equal(&x->condition, &y->condition)
+       || x->active_value != y->active_value || x->inactive_value != y->inactive_value) {
+      return false;
+    }
+  }
+  return i == a && j == b;
+}
+
+bool
+config_layer_rules_equal(struct wl_list *a, struct wl_list *b) {
+  struct wl_list *i = a->next, *j = b->next;
+  for(; i != a && j != b; i = i->next, j = j->next) {
+    struct layer_rule_blur *x = wl_container_of(i, x, link);
+    struct layer_rule_blur *y = wl_container_of(j, y, link);
+    if(strcmp(x->condition.source, y->condition.source) != 0) {
+      return false;
+    }
+  }
+  return i == a && j == b;
+}
+
+/* compares the two configs section by section, so a reload only redoes
+ * the work for the things that were actually edited */
+uint32_t
+config_diff(struct mwc_config *old, struct mwc_config *new) {
+  uint32_t changes = 0;
+
+  if(!config_outputs_equal(&old->outputs, &new->outputs)) {
+    changes |= CONFIG_CHANGED_OUTPUTS;
+  }
+
+  if(!strings_equal(old->keymap_layouts, new->keymap_layouts)
+     || !strings_equal(old->keymap_variants, new->keymap_variants)
+     || !strings_equal(old->keymap_options, new->keymap_options)) {
+    changes |= CONFIG_CHANGED_KEYMAP;
+  }
+  if(old->keyboard_rate != new->keyboard_rate
+     || old->keyboard_delay != new->keyboard_delay) {
+    changes |= CONFIG_CHANGED_KEYBOARD_REPEAT;
+  }
+
+  if(old->pointer_sensitivity != new->pointer_sensitivity
+     || old->pointer_acceleration != new->pointer_acceleration
+     || old->pointer_left_handed != new->pointer_left_handed
+     || old->trackpad_disable_while_typing != new->trackpad_disable_while_typing
+     || old->trackpad_natural_scroll != new->trackpad_natural_scroll
+     || old->trackpad_tap_to_click != new->trackpad_tap_to_click
+     || old->trackpad_scroll_method != new->trackpad_scroll_method
+     || !config_pointers_equal(&old->pointers, &new->pointers)) {
+    changes |= CONFIG_CHANGED_POINTERS;
+  }
+
+  if(!strings_equal(old->cursor_theme, new->cursor_theme)
+     || old->cursor_size != new->cursor_size) {
+    changes |= CONFIG_CHANGED_CURSOR;
+  }
+
+  if(old->master_count != new->master_count) {
+    changes |= CONFIG_CHANGED_MASTER_COUNT | CONFIG_CHANGED_LAYOUT;
+  }
+  if(old->master_ratio != new->master_ratio
+     || old->outer_gaps != new->outer_gaps
+     || old->inner_gaps != new->inner_gaps
+     || old->border_width != new->border_width) {
+    changes |= CONFIG_CHANGED_LAYOUT;
+  }
+
+  if(memcmp(old->active_border_color, new->active_border_color,
+            sizeof(old->active_border_color)) != 0
+     || memcmp(old->inactive_border_color, new->inactive_border_color,
+               sizeof(old->inactive_border_color)) != 0) {
+    changes |= CONFIG_CHANGED_BORDER_COLORS;
+  }
+  if(old->border_width != new->border_width
+     || old->border_radius != new->border_radius
+     || old->border_radius_location != new->border_radius_location) {
+    changes |= CONFIG_CHANGED_BORDER_SHAPE;
+  }
+
+  if(old->shadows != new->shadows
+     || old->shadows_size != new->shadows_size
+     || old->shadows_position.x != new->shadows_position.x
+     || old->shadows_position.y != new->shadows_position.y
+     || memcmp(old->shadows_color, new->shadows_color, sizeof(old->shadows_color)) != 0
+     || old->shadows_blur != new->shadows_blur) {
+    changes |= CONFIG_CHANGED_SHADOWS;
   }
 
-  if(toplevel->border != NULL) {
+  if(old->inactive_opacity != new->inactive_opacity
+     || old->active_opacity != new->active_opacity
+     || old->apply_opacity_when_fullscreen != new->apply_opacity_when_fullscreen
+     || !config_opacity_rules_equal(&old->window_rules.opacity, &new->window_rules.opacity)) {
+    changes |= CONFIG_CHANGED_OPACITY;
+  }
+
+  if(old->blur != new->blur) {
+    changes |= CONFIG_CHANGED_BLUR;
+  }
+  if(memcmp(&old->blur_params, &new->blur_params, sizeof(old->blur_params)) != 0) {
+    changes |= CONFIG_CHANGED_BLUR_PARAMS;
+  }
+  if(!config_layer_rules_equal(&old->layer_rules.blur, &new->layer_rules.blur)) {
+    changes |= CONFIG_CHANGED_LAYER_RULES;
+  }
+
+  if(old->client_side_decorations != new->client_side_decorations) {
+    changes |= CONFIG_CHANGED_DECORATIONS;
+  }
+
+  return changes;
+}
+
+void
+toplevel_apply_config_changes(struct mwc_toplevel *toplevel, uint32_t changes) {
+  uint32_t dirty = 0;
+
+  if(changes & CONFIG_CHANGED_OPACITY) {
+    toplevel_recheck_opacity_rules(toplevel);
+    /* apply_opacity_when_fullscreen does not change the values themselves */
+    dirty |= MWC_DIRTY_OPACITY;
+  }
+
+  /* the shape of the border and the shadow is only set when their nodes are created */
+  if(changes & CONFIG_CHANGED_BORDER_SHAPE && toplevel->border != NULL) {
     wlr_scene_node_destroy(&toplevel->border->node);
     toplevel->border = NULL;
   }
+  if(changes & (CONFIG_CHANGED_BORDER_SHAPE | CONFIG_CHANGED_SHADOWS)
+     && toplevel->shadow != NULL) {
+    wlr_scene_node_destroy(&toplevel->shadow->node);
+    toplevel->shadow = NULL;
+  }
+  if(changes & (CONFIG_CHANGED_BORDER_SHAPE | CONFIG_CHANGED_SHADOWS)) {
+    dirty |= MWC_DIRTY_RADIUS;
+  }
+
+  if(changes & CONFIG_CHANGED_BORDER_COLORS) {
+    dirty |= MWC_DIRTY_FOCUS;
+  }
+  if(changes & CONFIG_CHANGED_BLUR) {
+    dirty |= MWC_DIRTY_BLUR;
+  }
+
+  if(dirty != 0) {
+    toplevel_mark_effects_dirty(toplevel, dirty);
+  }
 }
 
 void
 layout_reorganize(struct mwc_workspace *workspace) {
-  uint32_t master_count = wl_list_length(&workspace->masters);
-  
-  if(master_count > server.config->master_count) {
-    while(master_count > server.config->master_count) {
-      struct wl_list *last = workspace->masters.prev;
-      wl_list_remove(last);
-      wl_list_insert(workspace->slaves.prev, last);
-      master_count--;
-    }
+  while(workspace->master_count > server.config->master_count) {
+    layout_demote_last_master(workspace);
+  }
 
-    return;
+  while(workspace->master_count < server.config->master_count
+        && workspace->slave_count > 0) {
+    struct mwc_toplevel *last = wl_container_of(workspace->slaves.prev, last, link);
+    layout_promote_slave(last);
   }
+}
 
-  uint32_t slave_count = wl_list_length(&workspace->slaves);
-  if(master_count < server.config->master_count && slave_count > 0) {
-    while(master_count < server.config->master_count && slave_count > 0) {
-      struct wl_list *last = workspace->slaves.prev;
-      wl_list_remove(last);
-      wl_list_insert(workspace->masters.prev, last);
-      master_count++;
-      slave_count--;
+void
+layer_surface_recheck_blur_rules(struct mwc_layer_surface *layer) {
+  struct layer_rule_blur *b;
+  wl_list_for_each(b, &server.config->layer_rules.blur, link) {
+    if(!b->condition.has || regexec(&b->condition.regex,
+                                    layer->wlr_layer_surface->namespace,
+                                    0, NULL, 0) == 0) {
+      wlr_scene_node_for_each_buffer(&layer->scene->tree->node,
+                                     iter_scene_buffer_apply_blur, (void *)1);
+      return;
     }
   }
+
+  wlr_scene_node_for_each_buffer(&layer->scene->tree->node,
+                                 iter_scene_buffer_apply_blur, (void *)0);
 }
 
 void
-config_reload() {
-  struct mwc_config *c = config_load();
-  if(c == NULL) {
-    wlr_log(WLR_ERROR, "could not reload the config, keeping the old one");
-    return;
+config_apply_env(struct mwc_config *c) {
+  struct env_config *e;
+  wl_list_for_each(e, &c->env, link) {
+    setenv(e->name, e->value, true);
   }
+}
 
+void
+config_apply(struct mwc_config *c) {
   /* we dont allow for hot reloading of workspaces, that would just be chaos */
 
   /* TODO: maybe only support adding new workspaces */
@@ -1210,74 +1642,101 @@ config_reload() {
     free(wc);
   }
 
-  c->workspaces = server.config->workspaces;
+  /* the list head moves to the new config, so the neighbours have to point to it */
+  wl_list_init(&c->workspaces);
+  wl_list_insert_list(&c->workspaces, &server.config->workspaces);
+  wl_list_init(&server.config->workspaces);
 
   struct mwc_config *old_config = server.config;
+  uint32_t changes = config_diff(old_config, c);
   server.config = c;
 
-  struct output_config *o;
-  wl_list_for_each(o, &c->outputs, link) {
-    struct mwc_output *out;
-    wl_list_for_each(out, &server.outputs, link) {
-      if(strcmp(o->name, out->wlr_output->name) == 0) {
+  wlr_log(WLR_DEBUG, "config changes mask %#x", changes);
+
+  config_apply_env(c);
+
+  if(changes & CONFIG_CHANGED_OUTPUTS) {
+    struct output_config *o;
+    wl_list_for_each(o, &c->outputs, link) {
+      struct mwc_output *out;
+      wl_list_for_each(out, &server.outputs, link) {
+        if(strcmp(o->name, out->wlr_output->name) != 0) continue;
+
         struct wlr_box output_box;
         wlr_output_layout_get_box(server.output_layout, out->wlr_output, &output_box);
 
+        bool changed = false;
         if(o->width != output_box.width
            || o->height != output_box.height
            || abs((int32_t)o->refresh_rate - (int32_t)out->wlr_output->refresh) > 1000
            || o->scale != out->wlr_output->scale) {
           output_initialize(out->wlr_output, o);
+          changed = true;
         }
 
         if(o->x != output_box.x || o->y != output_box.y) {
           output_add_to_layout(out, o);
+          changed = true;
         }
 
-        layer_surfaces_commit(out);
+        if(changed) {
+          layer_surfaces_commit(out);
+        }
       }
     }
   }
 
-  if(c->blur) {
+  if(changes & CONFIG_CHANGED_BLUR && c->blur) {
     struct mwc_output *output;
     wl_list_for_each(output, &server.outputs, link) {
-      if(output->blur != NULL) {
-        wlr_scene_node_destroy(&output->blur->node);
-      }
       struct wlr_box output_box;
       wlr_output_layout_get_box(server.output_layout, output->wlr_output, &output_box);
 
       output->blur = wlr_scene_optimized_blur_create(&server.scene->tree,
                                                      output_box.width, output_box.height);
-      wlr_scene_set_blur_data(server.scene, server.config->blur_params);
       wlr_scene_node_place_above(&output->blur->node, &server.background_tree->node);
       wlr_scene_node_set_position(&output->blur->node, output_box.x, output_box.y);
     }
-  } else if(old_config->blur) {
+    wlr_scene_set_blur_data(server.scene, c->blur_params);
+  } else if(changes & CONFIG_CHANGED_BLUR) {
     struct mwc_output *output;
     wl_list_for_each(output, &server.outputs, link) {
+      if(output->blur == NULL) continue;
       wlr_scene_node_destroy(&output->blur->node);
       output->blur = NULL;
     }
+  } else if(changes & CONFIG_CHANGED_BLUR_PARAMS && c->blur) {
+    wlr_scene_set_blur_data(server.scene, c->blur_params);
   }
 
-  struct mwc_keyboard *keyboard;
-  wl_list_for_each(keyboard, &server.keyboards, link) {
-    keyboard_configure(keyboard);
+  if(changes & (CONFIG_CHANGED_KEYMAP | CONFIG_CHANGED_KEYBOARD_REPEAT)) {
+    struct mwc_keyboard *keyboard;
+    wl_list_for_each(keyboard, &server.keyboards, link) {
+      if(changes & CONFIG_CHANGED_KEYMAP) {
+        keyboard_configure(keyboard);
+      } else {
+        wlr_keyboard_set_repeat_info(keyboard->wlr_keyboard,
+                                     c->keyboard_rate, c->keyboard_delay);
+      }
+    }
   }
 
-  struct mwc_pointer *pointer; 
-  wl_list_for_each(pointer, &server.pointers, link) {
-    pointer_configure(pointer);
+  if(changes & CONFIG_CHANGED_POINTERS) {
+    struct mwc_pointer *pointer; 
+    wl_list_for_each(pointer, &server.pointers, link) {
+      pointer_configure(pointer);
+    }
   }
 
+  uint32_t toplevel_changes = CONFIG_CHANGED_OPACITY | CONFIG_CHANGED_BORDER_SHAPE
+    | CONFIG_CHANGED_BORDER_COLORS | CONFIG_CHANGED_SHADOWS | CONFIG_CHANGED_BLUR;
+
   struct mwc_output *out;
   wl_list_for_each(out, &server.outputs, link) {
     struct mwc_workspace *w;
     wl_list_for_each(w, &out->workspaces, link) {
 
-      /* we rewire the keybinds */
+      /* the keybinds are new, so they always have to be rewired */
       struct keybind *k;
       wl_list_for_each(k, &server.config->keybinds, link) {
         if(k->action == keybind_change_workspace && (uint64_t)k->args == w->index) {
@@ -1290,116 +1749,242 @@ config_reload() {
         }
       }
 
-      if(c->master_count != old_config->master_count) {
+      if(changes & CONFIG_CHANGED_MASTER_COUNT) {
         layout_reorganize(w);
       }
 
-      struct mwc_toplevel *t;
-      wl_list_for_each(t, &w->floating_toplevels, link) {
-        toplevel_reapply_effects_etc(t);
-      }
-      wl_list_for_each(t, &w->masters, link) {
-        toplevel_reapply_effects_etc(t);
-      }
-      wl_list_for_each(t, &w->slaves, link) {
-        toplevel_reapply_effects_etc(t);
+      if(changes & toplevel_changes) {
+        struct mwc_toplevel *t;
+        wl_list_for_each(t, &w->floating_toplevels, link) {
+          toplevel_apply_config_changes(t, changes);
+        }
+        wl_list_for_each(t, &w->masters, link) {
+          toplevel_apply_config_changes(t, changes);
+        }
+        wl_list_for_each(t, &w->slaves, link) {
+          toplevel_apply_config_changes(t, changes);
+        }
       }
 
-      layout_set_pending_state(w);
-    }
-
-    struct mwc_layer_surface *layer;
-    for(size_t i = 0; i < 4; i++) {
-      wl_list_for_each(layer, &(&out->layers.background)[i], link) {
-        struct layer_rule_blur *b;
-        bool found = false;
-        wl_list_for_each(b, &server.config->layer_rules.blur, link) {
-          if(!b->condition.has || regexec(&b->condition.regex,
-                                          layer->wlr_layer_surface->namespace,
-                                          0, NULL, 0) == 0) {
-            wlr_scene_node_for_each_buffer(&layer->scene->tree->node,
-                                           iter_scene_buffer_apply_blur, (void *)1);
-            found = true;
-            break;
-          }
-        }
+      if(changes & CONFIG_CHANGED_LAYOUT) {
+        layout_set_pending_state(w);
+      }
+    }
 
-        if(!found) {
-          wlr_scene_node_for_each_buffer(&layer->scene->tree->node,
-                                         iter_scene_buffer_apply_blur, (void *)0);
+    if(changes & (CONFIG_CHANGED_LAYER_RULES | CONFIG_CHANGED_BLUR)) {
+      struct mwc_layer_surface *layer;
+      for(size_t i = 0; i < 4; i++) {
+        wl_list_for_each(layer, &(&out->layers.background)[i], link) {
+          layer_surface_recheck_blur_rules(layer);
         }
       }
     }
   }
 
-  wlr_server_decoration_manager_set_default_mode(server.kde_decoration_manager,
-                                                 c->client_side_decorations
-                                                 ? WLR_SERVER_DECORATION_MANAGER_MODE_CLIENT
-                                                 : WLR_SERVER_DECORATION_MANAGER_MODE_SERVER);
+  if(changes & CONFIG_CHANGED_DECORATIONS) {
+    wlr_server_decoration_manager_set_default_mode(server.kde_decoration_manager,
+                                                   c->client_side_decorations
+                                                   ? WLR_SERVER_DECORATION_MANAGER_MODE_CLIENT
+                                                   : WLR_SERVER_DECORATION_MANAGER_MODE_SERVER);
+  }
 
-  wlr_xcursor_manager_destroy(server.cursor_mgr);
+  if(changes & CONFIG_CHANGED_CURSOR) {
+    wlr_xcursor_manager_destroy(server.cursor_mgr);
 
-  server.cursor_mgr = wlr_xcursor_manager_create(server.config->cursor_theme,
-                                                 server.config->cursor_size);
-  char cursor_size[8];
-  snprintf(cursor_size, sizeof(cursor_size), "%u", server.config->cursor_size);
+    server.cursor_mgr = wlr_xcursor_manager_create(server.config->cursor_theme,
+                                                   server.config->cursor_size);
+    char cursor_size[8];
+    snprintf(cursor_size, sizeof(cursor_size), "%u", server.config->cursor_size);
 
-  cursor_size[7] = 0;
-  if(server.config->cursor_theme != NULL) {
-    setenv("XCURSOR_THEME", server.config->cursor_theme, true);
+    cursor_size[7] = 0;
+    if(server.config->cursor_theme != NULL) {
+      setenv("XCURSOR_THEME", server.config->cursor_theme, true);
+    }
+    setenv("XCURSOR_SIZE", cursor_size, true);
   }
-  setenv("XCURSOR_SIZE", cursor_size, true);
 
   config_destroy(old_config);
 }
 
+/* loads the config and checks it can be used, NULL if it cannot */
+struct mwc_config *
+config_load_valid(void) {
+  struct mwc_config *c = config_load(server.config_path);
+  if(c == NULL) {
+    wlr_log(WLR_ERROR, "could not reload the config, keeping the old one");
+    return NULL;
+  }
+
+  if(c->error_count > 0) {
+    wlr_log(WLR_ERROR, "config has %u invalid lines, keeping the old one", c->error_count);
+    config_discard(c);
+    return NULL;
+  }
+
+  return c;
+}
+
+void
+config_discard(struct mwc_config *c) {
+  struct workspace_config *wc, *wc_temp;
+  wl_list_for_each_safe(wc, wc_temp, &c->workspaces, link) {
+    free(wc->output);
+    free(wc);
+  }
+  wl_list_init(&c->workspaces);
+
+  config_destroy(c);
+}
+
+/* called on the parser thread, the event loop picks the config up in config_handle_pending */
 void
-idle_reload_config(void *data) {
+config_post_pending(struct mwc_config *c) {
+  pthread_mutex_lock(&server.pending_config_lock);
+  struct mwc_config *stale = server.pending_config;
+  server.pending_config = c;
+  pthread_mutex_unlock(&server.pending_config_lock);
+
+  /* the event loop did not get to the previous one yet, this one replaces it */
+  if(stale != NULL) {
+    config_discard(stale);
+  }
+
+  uint64_t one = 1;
+  if(write(server.config_eventfd, &one, sizeof(one)) < 0) {
+    wlr_log(WLR_ERROR, "could not wake up the event loop for the new config");
+  }
+}
+
+int
+config_handle_pending(int fd, uint32_t mask, void *data) {
+  uint64_t count;
+  if(read(fd, &count, sizeof(count)) < 0) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&server.pending_config_lock);
+  struct mwc_config *c = server.pending_config;
+  server.pending_config = NULL;
+  pthread_mutex_unlock(&server.pending_config_lock);
+
+  if(c == NULL) return 0;
+
   wlr_log(WLR_INFO, "reloading config");
-  config_reload();
+  config_apply(c);
+  return 0;
 }
 
-#define EVENT_SIZE (sizeof(struct inotify_event))
-#define BUF_LEN (16 * (EVENT_SIZE + 16))
+int
+config_handle_inotify(int fd, uint32_t mask, void *data) {
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
 
-void *
-config_watch(void *arg) {
-  char *dir = arg;
+  bool changed = false;
+  ssize_t length;
+  while((length = read(fd, buffer, sizeof(buffer))) > 0) {
+    for(char *ptr = buffer; ptr < buffer + length;
+        ptr += sizeof(struct inotify_event) + ((struct inotify_event *)ptr)->len) {
+      struct inotify_event *event = (struct inotify_event *)ptr;
+      /* we lost some events, so we cannot know if it was our file */
+      if(event->mask & IN_Q_OVERFLOW) {
+        changed = true;
+      } else if(event->len > 0 && strcmp(event->name, server.config_file_name) == 0) {
+        changed = true;
+      }
+    }
+  }
 
-  if(dir == NULL) return NULL;
+  /* editors write in chunks or save through a temporary file and a rename,
+   * so we wait for things to settle and reload once */
+  if(changed) {
+    wl_event_source_timer_update(server.config_debounce_timer, CONFIG_RELOAD_DEBOUNCE_MS);
+  }
 
-  int inotify_fd = inotify_init();
-  if(inotify_fd < 0) {
-    wlr_log(WLR_ERROR, "inotify failed to start");
-    return NULL;
+  return 0;
+}
+
+/* wakes up the parser thread, the config is applied once it is parsed */
+void
+config_request_parse(void) {
+  pthread_mutex_lock(&server.pending_config_lock);
+  server.config_parse_requested = true;
+  pthread_cond_signal(&server.config_parse_cond);
+  pthread_mutex_unlock(&server.pending_config_lock);
+}
+
+int
+config_handle_debounce(void *data) {
+  config_request_parse();
+  return 0;
+}
+
+bool
+config_watch_start(void) {
+  pthread_mutex_init(&server.pending_config_lock, NULL);
+  pthread_cond_init(&server.config_parse_cond, NULL);
+
+  server.config_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(server.config_eventfd < 0) {
+    wlr_log(WLR_ERROR, "could not create the eventfd for config reloads");
+    return false;
+  }
+
+  server.config_source = wl_event_loop_add_fd(server.wl_event_loop, server.config_eventfd,
+                                              WL_EVENT_READABLE, config_handle_pending, NULL);
+
+  /* started even without a config file to watch, the reload keybind goes through it too */
+  pthread_t thread;
+  if(pthread_create(&thread, NULL, config_watch, NULL) != 0) {
+    wlr_log(WLR_ERROR, "could not start the config parser thread");
+    return false;
   }
+  pthread_detach(thread);
+
+  if(server.config->dir == NULL) return true;
+
+  char *last_slash = strrchr(server.config_path, '/');
+  server.config_file_name = strdup(last_slash != NULL ? last_slash + 1 : server.config_path);
 
-  int wd = inotify_add_watch(inotify_fd, dir, IN_MODIFY);
-  if(wd < 0) {
+  server.config_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if(server.config_inotify_fd < 0) {
     wlr_log(WLR_ERROR, "inotify failed to start");
-    close(inotify_fd);
-    return NULL;
+    return false;
+  }
+
+  /* we watch the directory, as saving through a rename replaces the file we would watch */
+  if(inotify_add_watch(server.config_inotify_fd, server.config->dir,
+                       IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    wlr_log(WLR_ERROR, "inotify failed to watch %s", server.config->dir);
+    close(server.config_inotify_fd);
+    return false;
   }
 
-  char buffer[BUF_LEN];
+  server.config_inotify_source = wl_event_loop_add_fd(server.wl_event_loop,
+                                                      server.config_inotify_fd,
+                                                      WL_EVENT_READABLE,
+                                                      config_handle_inotify, NULL);
+  server.config_debounce_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                                         config_handle_debounce, NULL);
+
+  return true;
+}
+
+/* the event loop only decides when to reload, parsing and compiling the rules
+ * happens on this thread so it never stalls a frame */
+void *
+config_watch(void *arg) {
   while(1) {
-    ssize_t length = read(inotify_fd, buffer, BUF_LEN);
-    if(length < 0) {
-      wlr_log(WLR_ERROR, "inotify failed read");
-      break;
+    pthread_mutex_lock(&server.pending_config_lock);
+    while(!server.config_parse_requested) {
+      pthread_cond_wait(&server.config_parse_cond, &server.pending_config_lock);
     }
+    server.config_parse_requested = false;
+    pthread_mutex_unlock(&server.pending_config_lock);
 
-    for(char *ptr = buffer; ptr < buffer + length; ptr += EVENT_SIZE + ((struct inotify_event *)ptr)->len) {
-      struct inotify_event *event = (struct inotify_event *)ptr;
-      if(event->mask & IN_MODIFY) {
-        wl_event_loop_add_idle(server.wl_event_loop, idle_reload_config, NULL);
-      }
+    struct mwc_config *c = config_load_valid();
+    if(c != NULL) {
+      config_post_pending(c);
     }
   }
 
-  inotify_rm_watch(inotify_fd, wd);
-  close(inotify_fd);
-
   return NULL;
 }
-
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "helpers.h"
+#include "keybinds.h"
+#include "window_rules.h"
 
 #include <scenefx/types/fx/blur_data.h>
 #include <scenefx/types/fx/corner_location.h>
@@ -14,21 +16,107 @@
 #include <wayland-server-protocol.h>
 
 #define BAKED_POINTS_COUNT 256
+/* how long the config file has to stay untouched before it is reloaded */
+#define CONFIG_RELOAD_DEBOUNCE_MS 50
+/* the tokenizer allocates in blocks of at least this size */
+#define CONFIG_ARENA_BLOCK_SIZE (64 * 1024)
+/* size of the keyword table, see config_keyword_hash() */
+#define CONFIG_KEYWORD_SLOTS 128
+
+struct keybind;
+struct mwc_layout;
+
+enum config_keyword {
+  CONFIG_KEYWORD_NONE,
+  CONFIG_KEYWORD_MIN_TOPLEVEL_SIZE,
+  CONFIG_KEYWORD_KEYBOARD_RATE,
+  CONFIG_KEYWORD_KEYBOARD_DELAY,
+  CONFIG_KEYWORD_POINTER_SENSITIVITY,
+  CONFIG_KEYWORD_POINTER_ACCELERATION,
+  CONFIG_KEYWORD_POINTER,
+  CONFIG_KEYWORD_POINTER_LEFT_HANDED,
+  CONFIG_KEYWORD_TRACKPAD_DISABLE_WHILE_TYPING,
+  CONFIG_KEYWORD_NATURAL_SCROLL,
+  CONFIG_KEYWORD_TRACKPAD_NATURAL_SCROLL,
+  CONFIG_KEYWORD_TAP_TO_CLICK,
+  CONFIG_KEYWORD_TRACKPAD_TAP_TO_CLICK,
+  CONFIG_KEYWORD_TRACKPAD_SCROLL_METHOD,
+  CONFIG_KEYWORD_BORDER_WIDTH,
+  CONFIG_KEYWORD_OUTER_GAPS,
+  CONFIG_KEYWORD_INNER_GAPS,
+  CONFIG_KEYWORD_MASTER_RATIO,
+  CONFIG_KEYWORD_MASTER_COUNT,
+  CONFIG_KEYWORD_CURSOR_THEME,
+  CONFIG_KEYWORD_CURSOR_SIZE,
+  CONFIG_KEYWORD_INACTIVE_BORDER_COLOR,
+  CONFIG_KEYWORD_ACTIVE_BORDER_COLOR,
+  CONFIG_KEYWORD_OUTPUT,
+  CONFIG_KEYWORD_WORKSPACE,
+  CONFIG_KEYWORD_RUN,
+  CONFIG_KEYWORD_KEYBIND,
+  CONFIG_KEYWORD_ENV,
+  CONFIG_KEYWORD_WINDOW_RULE,
+  CONFIG_KEYWORD_ANIMATIONS,
+  CONFIG_KEYWORD_ANIMATION_DURATION,
+  CONFIG_KEYWORD_ANIMATION_CURVE,
+  CONFIG_KEYWORD_PLACEHOLDER_COLOR,
+  CONFIG_KEYWORD_CLIENT_SIDE_DECORATIONS,
+  CONFIG_KEYWORD_INACTIVE_OPACITY,
+  CONFIG_KEYWORD_ACTIVE_OPACITY,
+  CONFIG_KEYWORD_APPLY_OPACITY_WHEN_FULLSCREEN,
+  CONFIG_KEYWORD_KEYMAP,
+  CONFIG_KEYWORD_KEYMAP_OPTIONS,
+  CONFIG_KEYWORD_BORDER_RADIUS,
+  CONFIG_KEYWORD_BORDER_RADIUS_LOCATION,
+  CONFIG_KEYWORD_BLUR,
+  CONFIG_KEYWORD_BLUR_PASSES,
+  CONFIG_KEYWORD_BLUR_RADIUS,
+  CONFIG_KEYWORD_BLUR_NOISE,
+  CONFIG_KEYWORD_BLUR_BRIGHTNESS,
+  CONFIG_KEYWORD_BLUR_CONTRAST,
+  CONFIG_KEYWORD_BLUR_SATURATION,
+  CONFIG_KEYWORD_SHADOWS,
+  CONFIG_KEYWORD_SHADOWS_SIZE,
+  CONFIG_KEYWORD_SHADOWS_BLUR,
+  CONFIG_KEYWORD_SHADOWS_POSITION,
+  CONFIG_KEYWORD_SHADOWS_COLOR,
+  CONFIG_KEYWORD_LAYER_RULE,
+  /* not a keyword, keep it last */
+  CONFIG_KEYWORD_COUNT,
+};
+
+struct config_keyword_entry {
+  const char *name;
+  enum config_keyword keyword;
+};
+
+struct config_arena_block {
+  struct config_arena_block *next;
+  size_t used;
+  size_t cap;
+  char data[];
+};
 
-struct window_rule_regex {
-  bool has_app_id_regex;
-  regex_t app_id_regex;
-  bool has_title_regex;
-  regex_t title_regex;
+/* everything the tokenizer produces for one config file, freed all at once */
+struct config_arena {
+  struct config_arena_block *blocks;
+};
+
+/* cubic bezier going from (0, 0) to (1, 1) */
+struct bezier_curve {
+  /* x and y of the two control points in between */
+  double control_points[4];
+  /* y values of the curve at BAKED_POINTS_COUNT uniformly spaced x values in [0, 1] */
+  double baked_points[BAKED_POINTS_COUNT];
 };
 
 struct window_rule_float {
-  struct window_rule_regex condition;
+  struct window_rule_condition condition;
   struct wl_list link;
 };
 
 struct window_rule_size {
-  struct window_rule_regex condition;
+  struct window_rule_condition condition;
   struct wl_list link;
   bool relative_width;
   uint32_t width;
@@ -37,7 +125,7 @@ struct window_rule_size {
 };
 
 struct window_rule_opacity {
-  struct window_rule_regex condition;
+  struct window_rule_condition condition;
   struct wl_list link;
   double inactive_value;
   double active_value;
@@ -46,6 +134,8 @@ struct window_rule_opacity {
 struct layer_rule_regex {
   bool has;
   regex_t regex;
+  /* as written in the config, used to compare rules on reload */
+  char *source;
 };
 
 struct layer_rule_blur {
@@ -67,6 +157,14 @@ struct output_config {
 struct workspace_config {
   uint32_t index;
   char *output;
+  /* NULL for the default one */
+  const struct mwc_layout *layout;
+  struct wl_list link;
+};
+
+struct env_config {
+  char *name;
+  char *value;
   struct wl_list link;
 };
 
@@ -91,12 +189,16 @@ struct mwc_config {
   struct wl_list outputs;
   struct wl_list keybinds;
   struct wl_list pointer_keybinds;
+  /* built from the lists above once the whole config is parsed */
+  struct keybind_table keybind_table;
+  struct keybind_table pointer_keybind_table;
   struct wl_list workspaces;
   struct {
     struct wl_list floating;
     struct wl_list size;
     struct wl_list opacity;
   } window_rules;
+  struct window_rule_cache window_rule_cache;
 
   struct {
     struct wl_list blur;
@@ -105,6 +207,11 @@ struct mwc_config {
   /* keyboard stuff */
   char *keymap_layouts;
   char *keymap_variants;
+  /* how much is allocated for the two above, and how many layouts they hold.
+   * kept here since two configs can be parsed at the same time */
+  size_t keymap_layouts_cap;
+  size_t keymap_variants_cap;
+  size_t keymap_count;
   char *keymap_options;
   uint32_t keyboard_rate;
   uint32_t keyboard_delay;
@@ -157,50 +264,130 @@ struct mwc_config {
   /* animations stuff */
   bool animations;
   uint32_t animation_duration;
-  double animation_curve[4];
-  struct vec2 *baked_points;
+  struct bezier_curve animation_curve;
 
   /* run on startup */
   char *run[64];
   size_t run_count;
+
+  /* set on the main thread by config_apply_env, as the config might be parsed on another one */
+  struct wl_list env;
+
+  /* lines that could not be applied; a config with any of them is not reloaded */
+  uint32_t error_count;
+};
+
+/* what config_apply has to reapply, see config_diff() */
+enum config_changes {
+  CONFIG_CHANGED_OUTPUTS = 1 << 0,
+  CONFIG_CHANGED_KEYMAP = 1 << 1,
+  CONFIG_CHANGED_KEYBOARD_REPEAT = 1 << 2,
+  CONFIG_CHANGED_POINTERS = 1 << 3,
+  CONFIG_CHANGED_CURSOR = 1 << 4,
+  /* gaps, border width and the master area */
+  CONFIG_CHANGED_LAYOUT = 1 << 5,
+  CONFIG_CHANGED_MASTER_COUNT = 1 << 6,
+  CONFIG_CHANGED_BORDER_COLORS = 1 << 7,
+  /* width, radius and rounded corners */
+  CONFIG_CHANGED_BORDER_SHAPE = 1 << 8,
+  CONFIG_CHANGED_SHADOWS = 1 << 9,
+  /* also covers the opacity window rules */
+  CONFIG_CHANGED_OPACITY = 1 << 10,
+  /* blur turned on or off */
+  CONFIG_CHANGED_BLUR = 1 << 11,
+  CONFIG_CHANGED_BLUR_PARAMS = 1 << 12,
+  CONFIG_CHANGED_LAYER_RULES = 1 << 13,
+  CONFIG_CHANGED_DECORATIONS = 1 << 14,
 };
 
 struct vec2
-calculate_animation_curve_at(struct mwc_config *c, double t);
+calculate_animation_curve_at(struct bezier_curve *curve, double t);
 
 void
-bake_bezier_curve_points(struct mwc_config *c);
+bake_bezier_curve_points(struct bezier_curve *curve);
+
+double
+bezier_curve_sample(struct bezier_curve *curve, double x);
 
 bool
 config_add_window_rule(struct mwc_config *c, char *app_id_regex, char *title_regex,
                        char *predicate, char **args, size_t arg_count);
 
+/* fills in the action, stop and args of the keybind from its config form */
+bool
+config_parse_keybind_action(struct keybind *k, char *action, char **args, size_t arg_count);
+
 bool
 config_add_keybind(struct mwc_config *c, char *modifiers, char *key,
                    char* action, char **args, size_t arg_count);
 
+void *
+config_arena_alloc(struct config_arena *arena, size_t size);
+
 void
-config_free_args(char **args, size_t arg_count);
+config_arena_finish(struct config_arena *arena);
+
+uint32_t
+config_keyword_hash(const char *name, size_t len);
+
+void
+config_keywords_check(void);
+
+enum config_keyword
+config_keyword_from_name(const char *name);
 
 bool
 config_handle_value(struct mwc_config *c, char *keyword, char **args, size_t arg_count);
 
-/* assumes the line is newline teriminated, as it should be with fgets() */
+/* tokenizes the line in [line, end), without the newline; the keyword and
+ * args point into the arena */
 bool
-config_handle_line(char *line, size_t line_number, char **keyword,
-                   char ***args, size_t *args_count);
+config_handle_line(struct config_arena *arena, const char *line, const char *end,
+                   size_t line_number, char **keyword, char ***args, size_t *args_count);
+
+void
+config_resolve_paths(void);
 
 struct mwc_config *
-config_load();
+config_load(const char *path);
 
 void
 config_set_default_needed_params(struct mwc_config *c);
 
+/* returns a mask of enum config_changes */
+uint32_t
+config_diff(struct mwc_config *old, struct mwc_config *new);
+
+void
+config_apply_env(struct mwc_config *c);
+
+/* swaps c in for the current config and reapplies what changed */
 void
-config_reload();
+config_apply(struct mwc_config *c);
 
 void
 config_destroy(struct mwc_config *c);
 
+/* for configs that were never applied, so still own their workspaces */
+void
+config_discard(struct mwc_config *c);
+
+bool
+config_watch_start(void);
+
+int
+config_handle_pending(int fd, uint32_t mask, void *data);
+
+int
+config_handle_inotify(int fd, uint32_t mask, void *data);
+
+void
+config_request_parse(void);
+
+int
+config_handle_debounce(void *data);
+
+/* the parser thread, loads the config whenever the debounce timer
+ * or the reload keybind asks for it */
 void *
 config_watch(void *data);
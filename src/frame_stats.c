@@ -0,0 +1,91 @@
+#include "frame_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+const char *frame_stat_names[FRAME_STAT_COUNT] = {
+  [FRAME_STAT_DRAW] = "draw",
+  [FRAME_STAT_COMMIT] = "commit",
+  [FRAME_STAT_PRESENT] = "present",
+};
+
+uint32_t
+timespec_diff_us(struct timespec *end, struct timespec *start) {
+  int64_t us = (int64_t)(end->tv_sec - start->tv_sec) * 1000000
+    + (end->tv_nsec - start->tv_nsec) / 1000;
+  if(us < 0) return 0;
+  if(us > UINT32_MAX) return UINT32_MAX;
+  return us;
+}
+
+uint32_t
+frame_histogram_bucket(uint32_t us) {
+  uint32_t bucket = 0;
+  while(us > 0 && bucket < FRAME_STATS_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+void
+frame_histogram_add(struct frame_histogram *histogram, uint32_t us) {
+  /* if the ring is full the oldest sample falls out of its bucket */
+  if(histogram->count == FRAME_STATS_SAMPLES) {
+    uint32_t oldest = histogram->samples[histogram->head];
+    histogram->buckets[frame_histogram_bucket(oldest)]--;
+  } else {
+    histogram->count++;
+  }
+
+  histogram->samples[histogram->head] = us;
+  histogram->buckets[frame_histogram_bucket(us)]++;
+  histogram->head = (histogram->head + 1) % FRAME_STATS_SAMPLES;
+}
+
+void
+frame_stats_add_present(struct frame_stats *stats, struct timespec *when) {
+  if(stats->last_present.tv_sec != 0 || stats->last_present.tv_nsec != 0) {
+    frame_histogram_add(&stats->histograms[FRAME_STAT_PRESENT],
+                        timespec_diff_us(when, &stats->last_present));
+  }
+  stats->last_present = *when;
+}
+
+int
+frame_stats_compare_samples(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+void
+frame_stats_print(struct frame_stats *stats, const char *name, FILE *stream) {
+  uint32_t sorted[FRAME_STATS_SAMPLES];
+
+  for(size_t i = 0; i < FRAME_STAT_COUNT; i++) {
+    struct frame_histogram *h = &stats->histograms[i];
+    fprintf(stream, "%s %s samples %u", name, frame_stat_names[i], h->count);
+
+    if(h->count > 0) {
+      /* samples are only sorted here, so recording them stays cheap */
+      memcpy(sorted, h->samples, h->count * sizeof(*sorted));
+      qsort(sorted, h->count, sizeof(*sorted), frame_stats_compare_samples);
+
+      uint64_t sum = 0;
+      for(size_t j = 0; j < h->count; j++) {
+        sum += sorted[j];
+      }
+
+      fprintf(stream, " min %u avg %lu p50 %u p99 %u max %u",
+              sorted[0], (unsigned long)(sum / h->count), sorted[h->count / 2],
+              sorted[h->count * 99 / 100], sorted[h->count - 1]);
+    }
+
+    fprintf(stream, " buckets");
+    for(size_t j = 0; j < FRAME_STATS_BUCKETS; j++) {
+      fprintf(stream, "%c%u", j == 0 ? ' ' : ',', h->buckets[j]);
+    }
+    fprintf(stream, "\n");
+  }
+}
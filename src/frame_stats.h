@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* how many of the most recent frames the statistics are computed over */
+#define FRAME_STATS_SAMPLES 512
+/* bucket i holds samples in [2^(i - 1), 2^i) microseconds, the last one catches the rest */
+#define FRAME_STATS_BUCKETS 20
+
+enum frame_stat {
+  /* time spent in workspace_draw_frame */
+  FRAME_STAT_DRAW,
+  /* time spent in wlr_scene_output_commit */
+  FRAME_STAT_COMMIT,
+  /* time between two consecutive presentations */
+  FRAME_STAT_PRESENT,
+  FRAME_STAT_COUNT,
+};
+
+struct frame_histogram {
+  /* ring buffer of the last samples in microseconds */
+  uint32_t samples[FRAME_STATS_SAMPLES];
+  uint32_t head;
+  uint32_t count;
+  /* buckets only cover the samples that are still in the ring buffer */
+  uint32_t buckets[FRAME_STATS_BUCKETS];
+};
+
+struct frame_stats {
+  struct frame_histogram histograms[FRAME_STAT_COUNT];
+  struct timespec last_present;
+};
+
+uint32_t
+timespec_diff_us(struct timespec *end, struct timespec *start);
+
+void
+frame_histogram_add(struct frame_histogram *histogram, uint32_t us);
+
+void
+frame_stats_add_present(struct frame_stats *stats, struct timespec *when);
+
+void
+frame_stats_print(struct frame_stats *stats, const char *name, FILE *stream);
@@ -1,5 +1,7 @@
 #include "helpers.h"
 
+#include <string.h>
+
 void
 run_cmd(char *cmd) {
   if(fork() == 0) {
@@ -12,3 +14,14 @@ box_area(struct wlr_box *box) {
   return box->width * box->height;
 }
 
+double
+timespec_to_ms(struct timespec *time) {
+  return time->tv_sec * 1000.0 + time->tv_nsec / 1000000.0;
+}
+
+
+bool
+strings_equal(const char *a, const char *b) {
+  if(a == NULL || b == NULL) return a == b;
+  return strcmp(a, b) == 0;
+}
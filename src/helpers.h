@@ -1,6 +1,8 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 #include <wlr/util/box.h>
 
@@ -14,3 +16,10 @@ run_cmd(char *cmd);
 int
 box_area(struct wlr_box *box);
 
+double
+timespec_to_ms(struct timespec *time);
+
+/* NULL is only equal to NULL */
+bool
+strings_equal(const char *a, const char *b);
+
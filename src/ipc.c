@@ -1,29 +1,41 @@
 #include "ipc.h"
 
 #include "mwc.h"
-#include "array.h"
 #include "output.h"
 #include "workspace.h"
 #include "layer_surface.h"
+#include "toplevel.h"
+#include "keybinds.h"
+#include "config.h"
 
+#include <stdarg.h>
 #include <stdio.h>
-#include <signal.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <wayland-server-core.h>
 #include <wayland-util.h>
 #include <wlr/util/log.h>
 
 extern struct mwc_server server;
 
-void
-sigpipe_handler(int signum) {
-  /* do nothing */
-}
+const char *ipc_event_names[IPC_EVENT_COUNT] = {
+  [IPC_ACTIVE_WORKSPACE] = "active-workspace",
+  [IPC_ACTIVE_TOPLEVEL] = "active-toplevel",
+  [IPC_TREE] = "tree",
+};
+
+const char *ipc_query_names[IPC_QUERY_COUNT] = {
+  [IPC_QUERY_TOPLEVELS] = "toplevels",
+  [IPC_QUERY_LAYERS] = "layers",
+  [IPC_QUERY_OUTPUTS] = "outputs",
+};
 
 void
 ipc_create_message(enum ipc_event event, char *buffer, uint32_t length) {
@@ -45,6 +57,7 @@ ipc_create_message(enum ipc_event event, char *buffer, uint32_t length) {
       }
       break;
     }
+    case IPC_TREE:
     case IPC_EVENT_COUNT: {
       assert(false && "you should not have done this");
     }
@@ -52,247 +65,730 @@ ipc_create_message(enum ipc_event event, char *buffer, uint32_t length) {
 }
 
 void
-ipc_broadcast_message(enum ipc_event event) {
+ipc_buffer_reserve(struct ipc_buffer *buffer, size_t len) {
+  if(buffer->len + len <= buffer->cap) return;
+
+  size_t cap = buffer->cap == 0 ? 1024 : buffer->cap;
+  while(cap < buffer->len + len) {
+    cap *= 2;
+  }
+  buffer->data = realloc(buffer->data, cap);
+  buffer->cap = cap;
+}
+
+void
+ipc_buffer_append(struct ipc_buffer *buffer, const char *data, size_t len) {
+  if(len == 0) return;
+
+  ipc_buffer_reserve(buffer, len);
+  memcpy(buffer->data + buffer->len, data, len);
+  buffer->len += len;
+}
+
+void
+ipc_buffer_append_string(struct ipc_buffer *buffer, const char *string) {
+  /* app_ids and titles are NULL until the client sets them */
+  if(string == NULL) return;
+  ipc_buffer_append(buffer, string, strlen(string));
+}
+
+void
+ipc_buffer_printf(struct ipc_buffer *buffer, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  if(len <= 0) return;
+
+  /* vsnprintf wants room for the terminating 0 */
+  ipc_buffer_reserve(buffer, len + 1);
+  va_start(args, format);
+  vsnprintf(buffer->data + buffer->len, len + 1, format, args);
+  va_end(args);
+  buffer->len += len;
+}
+
+void
+ipc_client_destroy(struct ipc_client *client) {
+  wlr_log(WLR_INFO, "ipc: closing client on fd: %d", client->fd);
+
+  wl_event_source_remove(client->source);
+  close(client->fd);
+  wl_list_remove(&client->link);
+  free(client->queue.data);
+  free(client);
+}
+
+/* replies past this wait until the client reads, see ipc_client_handle_requests() */
+bool
+ipc_client_over_limit(struct ipc_client *client) {
+  return client->queue.len - client->queue_start > IPC_CLIENT_MAX_QUEUE;
+}
+
+/* writes as much of the queue as the socket takes without blocking,
+ * returns false if the client was destroyed */
+bool
+ipc_client_flush(struct ipc_client *client) {
+  while(client->queue_start < client->queue.len) {
+    ssize_t n = send(client->fd, client->queue.data + client->queue_start,
+                     client->queue.len - client->queue_start, MSG_NOSIGNAL);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+      ipc_client_destroy(client);
+      return false;
+    }
+    client->queue_start += n;
+  }
+
+  if(client->queue_start == client->queue.len) {
+    client->queue_start = 0;
+    client->queue.len = 0;
+
+    if(client->close_when_flushed) {
+      ipc_client_destroy(client);
+      return false;
+    }
+
+    wl_event_source_fd_update(client->source, WL_EVENT_READABLE);
+  } else {
+    /* the rest goes out once the socket is writable again. a client that sends
+     * requests without reading the replies is not read from until it catches up */
+    uint32_t mask = WL_EVENT_WRITABLE;
+    if(!ipc_client_over_limit(client)) {
+      mask |= WL_EVENT_READABLE;
+    }
+    wl_event_source_fd_update(client->source, mask);
+  }
+
+  return true;
+}
+
+/* queues a "<kind> <id> <len>\n" header followed by the payload,
+ * returns false if the client was destroyed */
+bool
+ipc_client_send(struct ipc_client *client, const char *kind, uint32_t id,
+                const char *data, size_t len) {
+  size_t pending = client->queue.len - client->queue_start;
+  if(client->queue_start > 0) {
+    memmove(client->queue.data, client->queue.data + client->queue_start, pending);
+    client->queue_start = 0;
+    client->queue.len = pending;
+  }
+
+  ipc_buffer_printf(&client->queue, "%s %u %zu\n", kind, id, len);
+  ipc_buffer_append(&client->queue, data, len);
+
+  return ipc_client_flush(client);
+}
+
+bool
+ipc_client_send_event(struct ipc_client *client, const char *data, size_t len) {
+  /* events are not requested one by one, so there is no reading to stop here.
+   * a subscriber that stopped reading is not worth keeping an ever growing queue for */
+  if(client->queue.len - client->queue_start + len > IPC_CLIENT_MAX_QUEUE) {
+    wlr_log(WLR_INFO, "ipc: client on fd %d is not reading its events, disconnecting",
+            client->fd);
+    ipc_client_destroy(client);
+    return false;
+  }
+
+  return ipc_client_send(client, "event", client->subscription_id, data, len);
+}
+
+bool
+ipc_has_subscribers(enum ipc_event event) {
+  struct ipc_client *client;
+  wl_list_for_each(client, &server.ipc_clients, link) {
+    if(client->subscribed && (client->events & (1 << event))) return true;
+  }
+  return false;
+}
+
+void
+ipc_schedule_flush(void) {
+  if(server.ipc_flush_scheduled) return;
+
+  wl_event_source_timer_update(server.ipc_flush_timer, IPC_EVENT_COALESCE_MS);
+  server.ipc_flush_scheduled = true;
+}
+
+void
+ipc_append_toplevel_map(struct ipc_buffer *buffer, struct mwc_toplevel *toplevel) {
+  struct ipc_toplevel_state *state = &toplevel->ipc_state;
+  state->mapped = true;
+  state->workspace = toplevel->workspace->index;
+  state->floating = toplevel->floating;
+  state->fullscreen = toplevel->fullscreen;
+  state->geometry = toplevel->current;
+
+  ipc_buffer_printf(buffer, "toplevel-map" SEPARATOR "%u" SEPARATOR "%u" SEPARATOR "%d"
+                    SEPARATOR "%d" SEPARATOR "%d" SEPARATOR "%d" SEPARATOR "%d" SEPARATOR "%d"
+                    SEPARATOR, toplevel->id, state->workspace, state->floating,
+                    state->fullscreen, state->geometry.x, state->geometry.y,
+                    state->geometry.width, state->geometry.height);
+  ipc_buffer_append_string(buffer, toplevel->xdg_toplevel->app_id);
+  ipc_buffer_append(buffer, SEPARATOR, strlen(SEPARATOR));
+  ipc_buffer_append_string(buffer, toplevel->xdg_toplevel->title);
+  ipc_buffer_append(buffer, SEPARATOR "\n", strlen(SEPARATOR "\n"));
+}
+
+/* compares the toplevel to what subscribers were last told and adds the differences */
+void
+ipc_append_toplevel_changes(struct ipc_buffer *buffer, struct mwc_toplevel *toplevel) {
+  struct ipc_toplevel_state *state = &toplevel->ipc_state;
+  if(!state->mapped) return;
+
+  if(state->workspace != toplevel->workspace->index) {
+    state->workspace = toplevel->workspace->index;
+    ipc_buffer_printf(buffer, "toplevel-workspace" SEPARATOR "%u" SEPARATOR "%u" SEPARATOR "\n",
+                      toplevel->id, state->workspace);
+  }
+
+  if(state->floating != toplevel->floating) {
+    state->floating = toplevel->floating;
+    ipc_buffer_printf(buffer, "toplevel-floating" SEPARATOR "%u" SEPARATOR "%d" SEPARATOR "\n",
+                      toplevel->id, state->floating);
+  }
+
+  if(state->fullscreen != toplevel->fullscreen) {
+    state->fullscreen = toplevel->fullscreen;
+    ipc_buffer_printf(buffer, "toplevel-fullscreen" SEPARATOR "%u" SEPARATOR "%d" SEPARATOR "\n",
+                      toplevel->id, state->fullscreen);
+  }
+
+  if(!wlr_box_equal(&state->geometry, &toplevel->current)) {
+    state->geometry = toplevel->current;
+    ipc_buffer_printf(buffer, "toplevel-geometry" SEPARATOR "%u" SEPARATOR "%d" SEPARATOR "%d"
+                      SEPARATOR "%d" SEPARATOR "%d" SEPARATOR "\n", toplevel->id,
+                      state->geometry.x, state->geometry.y,
+                      state->geometry.width, state->geometry.height);
+  }
+}
+
+/* calls f on every mapped toplevel, including the grabbed one which is in no list */
+void
+ipc_for_each_toplevel(void (*f)(struct ipc_buffer *, struct mwc_toplevel *),
+                      struct ipc_buffer *buffer) {
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    struct mwc_workspace *workspace;
+    wl_list_for_each(workspace, &output->workspaces, link) {
+      struct mwc_toplevel *toplevel;
+      wl_list_for_each(toplevel, &workspace->floating_toplevels, link) {
+        f(buffer, toplevel);
+      }
+      wl_list_for_each(toplevel, &workspace->masters, link) {
+        f(buffer, toplevel);
+      }
+      wl_list_for_each(toplevel, &workspace->slaves, link) {
+        f(buffer, toplevel);
+      }
+    }
+  }
+
+  if(server.grabbed_toplevel != NULL) {
+    f(buffer, server.grabbed_toplevel);
+  }
+}
+
+/* sends out everything that changed in the tree since the last flush */
+void
+ipc_flush_tree(void) {
+  if(server.ipc_tree_dirty) {
+    server.ipc_tree_dirty = false;
+    if(ipc_has_subscribers(IPC_TREE)) {
+      ipc_for_each_toplevel(ipc_append_toplevel_changes, &server.ipc_tree_events);
+    }
+  }
+
+  struct ipc_buffer *events = &server.ipc_tree_events;
+  if(events->len == 0) return;
+
+  struct ipc_client *client, *tmp;
+  wl_list_for_each_safe(client, tmp, &server.ipc_clients, link) {
+    if(client->subscribed && (client->events & (1 << IPC_TREE))) {
+      ipc_client_send_event(client, events->data, events->len);
+    }
+  }
+  events->len = 0;
+}
+
+void
+ipc_toplevel_map(struct mwc_toplevel *toplevel) {
   if(!server.ipc_running) return;
 
+  if(!ipc_has_subscribers(IPC_TREE)) {
+    /* the tree is sent whole on subscribe, which fills the rest of the state */
+    toplevel->ipc_state.mapped = true;
+    return;
+  }
+
+  ipc_append_toplevel_map(&server.ipc_tree_events, toplevel);
+  ipc_schedule_flush();
+}
+
+void
+ipc_toplevel_unmap(struct mwc_toplevel *toplevel) {
+  if(!server.ipc_running || !toplevel->ipc_state.mapped) return;
+  toplevel->ipc_state.mapped = false;
+
+  if(!ipc_has_subscribers(IPC_TREE)) return;
+
+  ipc_buffer_printf(&server.ipc_tree_events, "toplevel-unmap" SEPARATOR "%u" SEPARATOR "\n",
+                    toplevel->id);
+  ipc_schedule_flush();
+}
+
+/* the actual differences are found once per flush, so this is cheap to call often */
+void
+ipc_toplevel_changed(void) {
+  if(!server.ipc_running || server.ipc_tree_dirty) return;
+
+  server.ipc_tree_dirty = true;
+  ipc_schedule_flush();
+}
+
+void
+ipc_append_workspace_output(struct ipc_buffer *buffer, struct mwc_workspace *workspace) {
+  ipc_buffer_printf(buffer, "workspace-output" SEPARATOR "%u" SEPARATOR "%s" SEPARATOR "\n",
+                    workspace->index, workspace->output->wlr_output->name);
+}
+
+void
+ipc_workspace_output(struct mwc_workspace *workspace) {
+  if(!server.ipc_running || !ipc_has_subscribers(IPC_TREE)) return;
+
+  ipc_append_workspace_output(&server.ipc_tree_events, workspace);
+  ipc_schedule_flush();
+}
+
+void
+ipc_append_output_add(struct ipc_buffer *buffer, struct mwc_output *output) {
+  ipc_buffer_printf(buffer, "output-add" SEPARATOR "%s" SEPARATOR "\n", output->wlr_output->name);
+
+  struct mwc_workspace *workspace;
+  wl_list_for_each(workspace, &output->workspaces, link) {
+    ipc_append_workspace_output(buffer, workspace);
+  }
+}
+
+void
+ipc_output_add(struct mwc_output *output) {
+  if(!server.ipc_running || !ipc_has_subscribers(IPC_TREE)) return;
+
+  ipc_append_output_add(&server.ipc_tree_events, output);
+  ipc_schedule_flush();
+}
+
+void
+ipc_output_remove(struct mwc_output *output) {
+  if(!server.ipc_running || !ipc_has_subscribers(IPC_TREE)) return;
+
+  ipc_buffer_printf(&server.ipc_tree_events, "output-remove" SEPARATOR "%s" SEPARATOR "\n",
+                    output->wlr_output->name);
+  ipc_schedule_flush();
+}
+
+/* the whole tree in the same form as the changes, followed by tree-done */
+void
+ipc_append_tree(struct ipc_buffer *buffer) {
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    ipc_append_output_add(buffer, output);
+  }
+
+  ipc_for_each_toplevel(ipc_append_toplevel_map, buffer);
+  ipc_buffer_append_string(buffer, "tree-done" SEPARATOR "\n");
+}
+
+int
+ipc_flush_events(void *data) {
+  server.ipc_flush_scheduled = false;
+  ipc_flush_tree();
+
+  uint32_t pending = server.ipc_pending_events;
+  server.ipc_pending_events = 0;
+
   char message[512];
-  ipc_create_message(event, message, sizeof(message));
-
-  for(size_t i = 0; i < array_len(server.ipc_clients); i++) {
-    if(write(server.ipc_clients[i], message, strlen(message)) < 0) {
-      wlr_log(WLR_INFO, "could not write to client %d, assuming closed", server.ipc_clients[i]);
-      close(server.ipc_clients[i]);
-      array_remove(&server.ipc_clients, i);
-      i--;
+  for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
+    if(!(pending & (1 << i))) continue;
+
+    ipc_create_message(i, message, sizeof(message));
+    /* e.g. focus moving away and back within the same frame */
+    if(strcmp(message, server.ipc_last_events[i]) == 0) continue;
+    strcpy(server.ipc_last_events[i], message);
+
+    size_t len = strlen(message);
+    struct ipc_client *client, *tmp;
+    wl_list_for_each_safe(client, tmp, &server.ipc_clients, link) {
+      if(client->subscribed && (client->events & (1 << i))) {
+        ipc_client_send_event(client, message, len);
+      }
     }
   }
+
+  return 0;
 }
 
+/* the event is only marked here and sent from ipc_flush_events, so a burst of
+ * focus or workspace changes ends up as a single message per event */
 void
-ipc_add_client(int fd) {
-  array_push(&server.ipc_clients, fd);
+ipc_broadcast_message(enum ipc_event event) {
+  if(!server.ipc_running) return;
+
+  server.ipc_pending_events |= 1 << event;
+  ipc_schedule_flush();
+}
+
+/* no arguments means all the events, otherwise they are event names */
+bool
+ipc_parse_events(char *args, uint32_t *events) {
+  *events = 0;
+
+  char *saveptr;
+  char *name = strtok_r(args, " ", &saveptr);
+  while(name != NULL) {
+    size_t i = 0;
+    while(i < IPC_EVENT_COUNT && strcmp(name, ipc_event_names[i]) != 0) {
+      i++;
+    }
+    if(i == IPC_EVENT_COUNT) return false;
+
+    *events |= 1 << i;
+    name = strtok_r(NULL, " ", &saveptr);
+  }
+
+  if(*events == 0) {
+    *events = IPC_EVENT_DEFAULT;
+  }
+  return true;
+}
+
+/* returns false if the client was destroyed */
+bool
+ipc_subscribe(struct ipc_client *client, uint32_t id, uint32_t events) {
+  /* everyone else has to get the changes so far before the tree state is reset below */
+  if(events & (1 << IPC_TREE)) {
+    ipc_flush_tree();
+  }
+
+  /* a connection has one subscription, subscribing again replaces it */
+  client->subscribed = true;
+  client->subscription_id = id;
+  client->events = events;
+
+  if(!ipc_client_send(client, "reply", id, "ok\n", strlen("ok\n"))) return false;
+
+  /* the current state only goes to the new subscriber */
+  char message[512];
   for(size_t i = 0; i < IPC_EVENT_COUNT; i++) {
-    ipc_broadcast_message(i);
+    if(i == IPC_TREE || !(client->events & (1 << i))) continue;
+
+    ipc_create_message(i, message, sizeof(message));
+    if(!ipc_client_send_event(client, message, strlen(message))) return false;
   }
+
+  if(client->events & (1 << IPC_TREE)) {
+    struct ipc_buffer *tree = &server.ipc_reply;
+    tree->len = 0;
+    ipc_append_tree(tree);
+    /* this one can be big, it does not count against the queue limit */
+    return ipc_client_send(client, "event", id, tree->data, tree->len);
+  }
+
+  return true;
 }
 
-/* this is horrendous, but i dont care, never going to touch it again */
 void
-ipc_handle_simple(char *request, int fd) {
-  size_t len = 0;
-  size_t cap = STRING_INITIAL_LENGTH;
-  char *message = calloc(cap, sizeof(char));
-  char *p = message;
-  if(strcmp(request, "toplevels") == 0) {
+ipc_run_keybind(struct keybind *k) {
+  /* same as with the config keybinds, workspace actions only have an index */
+  if(!k->initialized) {
     struct mwc_output *output;
     wl_list_for_each(output, &server.outputs, link) {
       struct mwc_workspace *workspace;
       wl_list_for_each(workspace, &output->workspaces, link) {
-        struct mwc_toplevel *toplevel;
-        wl_list_for_each(toplevel, &workspace->floating_toplevels, link) {
-          char *q = toplevel->xdg_toplevel->app_id;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          if(len >= cap) {
-            cap *= 2;
-            message = realloc(message, cap);
-            p = message + len;
-          }
-
-          *p = ',';
-          p++;
-          len++;
-
-          q = toplevel->xdg_toplevel->title;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          *p = '\n';
-          p++;
-          len++;
+        if(!k->initialized && (uint64_t)k->args == workspace->index) {
+          k->args = workspace;
+          k->initialized = true;
         }
+      }
+    }
+  }
 
-        wl_list_for_each(toplevel, &workspace->masters, link) {
-          char *q = toplevel->xdg_toplevel->app_id;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          if(len >= cap) {
-            cap *= 2;
-            message = realloc(message, cap);
-            p = message + len;
-          }
+  if(k->initialized) {
+    k->action(k->args);
+  } else {
+    wlr_log(WLR_ERROR, "ipc: there is no workspace %lu", (uint64_t)k->args);
+  }
 
-          *p = ',';
-          p++;
-          len++;
-
-          q = toplevel->xdg_toplevel->title;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          *p = '\n';
-          p++;
-          len++;
-        }
+  if(k->action == keybind_run) {
+    free(k->args);
+  }
+}
 
-        wl_list_for_each(toplevel, &workspace->slaves, link) {
-          char *q = toplevel->xdg_toplevel->app_id;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          if(len >= cap) {
-            cap *= 2;
-            message = realloc(message, cap);
-            p = message + len;
-          }
+/* runs a keybind action as if it was pressed, e.g. "dispatch workspace 2" */
+bool
+ipc_dispatch(char *request) {
+  char *args[8];
+  size_t arg_count = 0;
 
-          *p = ',';
-          p++;
-          len++;
-
-          q = toplevel->xdg_toplevel->title;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
-          }
-          
-          *p = '\n';
-          p++;
-          len++;
+  char *saveptr;
+  char *action = strtok_r(request, " ", &saveptr);
+  if(action == NULL) return false;
+
+  char *arg;
+  while(arg_count < 8 && (arg = strtok_r(NULL, " ", &saveptr)) != NULL) {
+    args[arg_count] = arg;
+    arg_count++;
+  }
+
+  struct keybind k = {0};
+  if(!config_parse_keybind_action(&k, action, args, arg_count)) return false;
+
+  /* move and resize only make sense while a button is held */
+  if(k.stop != NULL) return false;
+
+  /* requests are handled from the event loop, so the action can run right away
+   * instead of being handed over through an idle source */
+  ipc_run_keybind(&k);
+  return true;
+}
+
+void
+ipc_append_toplevels(struct ipc_buffer *reply, struct wl_list *toplevels) {
+  struct mwc_toplevel *toplevel;
+  wl_list_for_each(toplevel, toplevels, link) {
+    ipc_buffer_append_string(reply, toplevel->xdg_toplevel->app_id);
+    ipc_buffer_append(reply, ",", 1);
+    ipc_buffer_append_string(reply, toplevel->xdg_toplevel->title);
+    ipc_buffer_append(reply, "\n", 1);
+  }
+}
+
+void
+ipc_serialize_query(enum ipc_query query, struct ipc_buffer *reply) {
+  switch(query) {
+    case IPC_QUERY_TOPLEVELS: {
+      struct mwc_output *output;
+      wl_list_for_each(output, &server.outputs, link) {
+        struct mwc_workspace *workspace;
+        wl_list_for_each(workspace, &output->workspaces, link) {
+          ipc_append_toplevels(reply, &workspace->floating_toplevels);
+          ipc_append_toplevels(reply, &workspace->masters);
+          ipc_append_toplevels(reply, &workspace->slaves);
         }
       }
+      break;
     }
-  } else if(strcmp(request, "layers") == 0) {
-    struct mwc_output *output;
-    wl_list_for_each(output, &server.outputs, link) {
-      struct mwc_layer_surface *layer;
-      for(size_t i = 0; i < 4; i++) {
-        wl_list_for_each(layer, &(&output->layers.background)[i], link) {
-          char *q = layer->wlr_layer_surface->namespace;
-          while(*q != 0) {
-            if(len >= cap) {
-              cap *= 2;
-              message = realloc(message, cap);
-              p = message + len;
-            }
-            *p = *q;
-            p++;
-            q++;
-            len++;
+    case IPC_QUERY_LAYERS: {
+      struct mwc_output *output;
+      wl_list_for_each(output, &server.outputs, link) {
+        struct mwc_layer_surface *layer;
+        for(size_t i = 0; i < 4; i++) {
+          wl_list_for_each(layer, &(&output->layers.background)[i], link) {
+            ipc_buffer_append_string(reply, layer->wlr_layer_surface->namespace);
+            ipc_buffer_append(reply, "\n", 1);
           }
-
-          if(len >= cap) {
-            cap *= 2;
-            message = realloc(message, cap);
-            p = message + len;
-          }
-
-          *p = '\n';
-          p++;
-          len++;
         }
       }
+      break;
     }
-  } else if(strcmp(request, "outputs") == 0) {
-    struct mwc_output *output;
-    wl_list_for_each(output, &server.outputs, link) {
-      char *q = output->wlr_output->name;
-      while(*q != 0) {
-        if(len >= cap) {
-          cap *= 2;
-          message = realloc(message, cap);
-          p = message + len;
-        }
-        *p = *q;
-        p++;
-        q++;
-        len++;
+    case IPC_QUERY_OUTPUTS: {
+      struct mwc_output *output;
+      wl_list_for_each(output, &server.outputs, link) {
+        ipc_buffer_append_string(reply, output->wlr_output->name);
+        ipc_buffer_append(reply, "\n", 1);
       }
+      break;
+    }
+    case IPC_QUERY_COUNT: {
+      assert(false && "you should not have done this");
+    }
+  }
+}
 
-      if(len >= cap) {
-        cap *= 2;
-        message = realloc(message, cap);
-        p = message + len;
-      }
+/* marks the cached reply of the query as out of date */
+void
+ipc_invalidate(enum ipc_query query) {
+  server.ipc_generations[query]++;
+}
 
-      *p = '\n';
-      p++;
-      len++;
-    }
+/* the reply is only serialized again if something changed since the last time,
+ * so polling an unchanged tree is a copy of the cached bytes */
+struct ipc_buffer *
+ipc_query(enum ipc_query query) {
+  struct ipc_snapshot *snapshot = &server.ipc_snapshots[query];
+  if(snapshot->generation != server.ipc_generations[query]) {
+    snapshot->data.len = 0;
+    ipc_serialize_query(query, &snapshot->data);
+    snapshot->generation = server.ipc_generations[query];
+  }
+  return &snapshot->data;
+}
+
+void
+ipc_handle_simple(char *request, struct ipc_buffer *reply) {
+  if(strcmp(request, "frame-stats") == 0) {
+    char *stats;
+    size_t len;
+    FILE *stream = open_memstream(&stats, &len);
+    output_print_frame_stats(stream);
+    fclose(stream);
+    ipc_buffer_append(reply, stats, len);
+    free(stats);
+  } else if(strcmp(request, "frame-stats-reset") == 0) {
+    /* same thread as the frame handlers that fill the stats in */
+    output_reset_frame_stats();
+    ipc_buffer_append_string(reply, "ok\n");
+  } else if(strncmp(request, "dispatch ", 9) == 0 && ipc_dispatch(request + 9)) {
+    ipc_buffer_append_string(reply, "ok\n");
   } else {
-    message = "invalid request\n";
-    len = strlen(message);
+    ipc_buffer_append_string(reply, "invalid request\n");
   }
+}
 
-  write(fd, message, len);
-  free(message);
-  close(fd);
+/* handles a single "<id> <request>" line, returns false if the client was destroyed */
+bool
+ipc_handle_request(struct ipc_client *client, char *line) {
+  char *request;
+  uint32_t id = strtoul(line, &request, 10);
+  if(request == line || *request != ' ') {
+    return ipc_client_send(client, "reply", 0, "invalid request\n",
+                           strlen("invalid request\n"));
+  }
+  request++;
+
+  if(strcmp(request, "subscribe") == 0
+     || strncmp(request, "subscribe ", strlen("subscribe ")) == 0) {
+    uint32_t events;
+    if(ipc_parse_events(request + strlen("subscribe"), &events)) {
+      return ipc_subscribe(client, id, events);
+    }
+    return ipc_client_send(client, "reply", id, "invalid request\n",
+                           strlen("invalid request\n"));
+  }
+
+  for(size_t i = 0; i < IPC_QUERY_COUNT; i++) {
+    if(strcmp(request, ipc_query_names[i]) == 0) {
+      struct ipc_buffer *reply = ipc_query(i);
+      return ipc_client_send(client, "reply", id, reply->data, reply->len);
+    }
+  }
+
+  /* replies are built in the same buffer every time, it only ever grows */
+  struct ipc_buffer *reply = &server.ipc_reply;
+  reply->len = 0;
+  ipc_handle_simple(request, reply);
+
+  return ipc_client_send(client, "reply", id, reply->data, reply->len);
+}
+
+/* a single read can have any number of requests, and the last one may be partial.
+ * handling stops while the queue is over the limit, the rest waits in the buffer
+ * until the client reads its replies; returns false if the client was destroyed */
+bool
+ipc_client_handle_requests(struct ipc_client *client) {
+  if(client->close_when_flushed) return true;
+
+  char *start = client->request;
+  char *end = client->request + client->request_len;
+  char *newline;
+  while(!ipc_client_over_limit(client)
+        && (newline = memchr(start, '\n', end - start)) != NULL) {
+    *newline = 0;
+    if(!ipc_handle_request(client, start)) return false;
+    start = newline + 1;
+  }
+
+  client->request_len = end - start;
+  memmove(client->request, start, client->request_len);
+  return true;
+}
+
+int
+ipc_handle_client(int fd, uint32_t mask, void *data) {
+  struct ipc_client *client = data;
+
+  if(mask & WL_EVENT_WRITABLE) {
+    if(!ipc_client_flush(client)) return 0;
+    /* requests that were held back while the queue was full */
+    if(!ipc_client_handle_requests(client)) return 0;
+  }
+
+  if(mask & WL_EVENT_READABLE) {
+    /* once we gave up on a client it only waits for its last reply to go out */
+    if(client->close_when_flushed) return 0;
+    /* reading resumes once the replies it already asked for are out */
+    if(ipc_client_over_limit(client)) return 0;
+
+    ssize_t len = read(fd, client->request + client->request_len,
+                       IPC_MAX_REQUEST - client->request_len);
+    if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return 0;
+    if(len <= 0) {
+      ipc_client_destroy(client);
+      return 0;
+    }
+    client->request_len += len;
+
+    if(!ipc_client_handle_requests(client)) return 0;
+
+    bool complete = memchr(client->request, '\n', client->request_len) != NULL;
+    if(client->request_len == IPC_MAX_REQUEST && !complete) {
+      wlr_log(WLR_INFO, "ipc: request from client on fd %d is too long", client->fd);
+      client->close_when_flushed = true;
+      ipc_client_send(client, "reply", 0, "invalid request\n", strlen("invalid request\n"));
+    }
+    return 0;
+  }
+
+  if(mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+    ipc_client_destroy(client);
+  }
+
+  return 0;
+}
+
+int
+ipc_handle_connection(int fd, uint32_t mask, void *data) {
+  while(1) {
+    int client_fd = accept(fd, NULL, NULL);
+    if(client_fd == -1) {
+      if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        wlr_log(WLR_ERROR, "ipc: accept failed: %s", strerror(errno));
+      }
+      return 0;
+    }
+
+    wlr_log(WLR_INFO, "ipc: new client on fd: %d", client_fd);
+
+    fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) | O_NONBLOCK);
+    fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+
+    struct ipc_client *client = calloc(1, sizeof(*client));
+    client->fd = client_fd;
+    client->source = wl_event_loop_add_fd(server.wl_event_loop, client_fd,
+                                          WL_EVENT_READABLE, ipc_handle_client, client);
+    if(client->source == NULL) {
+      close(client_fd);
+      free(client);
+      continue;
+    }
+    wl_list_insert(&server.ipc_clients, &client->link);
+  }
 }
 
-void *
-ipc_run(void *data) {
-  struct sigaction sa;
-  sa.sa_handler = sigpipe_handler;
-  sa.sa_flags = 0;
-  sigemptyset(&sa.sa_mask);
+bool
+ipc_init(void) {
+  wl_list_init(&server.ipc_clients);
 
-  if(sigaction(SIGPIPE, &sa, NULL) == -1) goto no_close;
+  /* snapshots start at generation 0, so the first query always builds them */
+  for(size_t i = 0; i < IPC_QUERY_COUNT; i++) {
+    server.ipc_generations[i] = 1;
+  }
 
-  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
   if(fd == -1) goto no_close;
 
   struct sockaddr_un address = {0};
@@ -302,34 +798,41 @@ ipc_run(void *data) {
   if(bind(fd, (struct sockaddr *)&address, sizeof(address))) goto error;
   if(listen(fd, 128) == -1) goto error;
 
-  array_init(&server.ipc_clients);
-  server.ipc_running = true;
-
-  char buffer[1024];
-  while(1) {
-    struct sockaddr_un client_address;
-    socklen_t sock_len;
-    int client = accept(fd, (struct sockaddr *)&client_address, &sock_len);
-    if(client == -1) continue;
-
-    wlr_log(WLR_INFO, "ipc: new client on fd: %d", client);
+  server.ipc_source = wl_event_loop_add_fd(server.wl_event_loop, fd, WL_EVENT_READABLE,
+                                           ipc_handle_connection, NULL);
+  if(server.ipc_source == NULL) goto error;
 
-    ssize_t len = read(client, buffer, sizeof(buffer) - 1);
-    if(len < 0) continue;
+  server.ipc_flush_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                                   ipc_flush_events, NULL);
 
-    buffer[len] = 0;
-
-    if(strcmp(buffer, "subscribe") == 0) {
-      ipc_add_client(client);
-    } else {
-      ipc_handle_simple(buffer, client);
-    }
-  }
+  server.ipc_fd = fd;
+  server.ipc_running = true;
+  return true;
 
 error:
   wlr_log(WLR_ERROR, "ipc: %s", strerror(errno));
   close(fd);
 no_close:
   unlink(IPC_PATH);
-  return NULL;
+  return false;
+}
+
+void
+ipc_finish(void) {
+  if(!server.ipc_running) return;
+
+  struct ipc_client *client, *tmp;
+  wl_list_for_each_safe(client, tmp, &server.ipc_clients, link) {
+    ipc_client_destroy(client);
+  }
+
+  free(server.ipc_reply.data);
+  free(server.ipc_tree_events.data);
+  for(size_t i = 0; i < IPC_QUERY_COUNT; i++) {
+    free(server.ipc_snapshots[i].data.data);
+  }
+  wl_event_source_remove(server.ipc_flush_timer);
+  wl_event_source_remove(server.ipc_source);
+  close(server.ipc_fd);
+  server.ipc_running = false;
 }
@@ -1,13 +1,115 @@
+#pragma once
+
 #include "ipc_shared.h"
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/util/box.h>
+
+/* how much unsent data a subscriber can have before we give up on it */
+#define IPC_CLIENT_MAX_QUEUE (64 * 1024)
+/* events of the same kind that happen within this many ms are sent once,
+ * roughly a frame at 60hz */
+#define IPC_EVENT_COALESCE_MS 16
+
 enum ipc_event {
   IPC_ACTIVE_WORKSPACE,
   IPC_ACTIVE_TOPLEVEL,
+  /* not a single message like the others, but a stream of changes to the window tree */
+  IPC_TREE,
   IPC_EVENT_COUNT,
 };
 
+/* what a plain "subscribe" gets, the tree has to be asked for */
+#define IPC_EVENT_DEFAULT ((1 << IPC_ACTIVE_WORKSPACE) | (1 << IPC_ACTIVE_TOPLEVEL))
+
+extern const char *ipc_event_names[IPC_EVENT_COUNT];
+
+/* queries whose replies are cached until the state they list changes */
+enum ipc_query {
+  IPC_QUERY_TOPLEVELS,
+  IPC_QUERY_LAYERS,
+  IPC_QUERY_OUTPUTS,
+  IPC_QUERY_COUNT,
+};
+
+extern const char *ipc_query_names[IPC_QUERY_COUNT];
+
+struct ipc_buffer {
+  char *data;
+  size_t len;
+  size_t cap;
+};
+
+/* what tree subscribers were last told about a toplevel */
+struct ipc_toplevel_state {
+  bool mapped;
+  uint32_t workspace;
+  bool floating;
+  bool fullscreen;
+  struct wlr_box geometry;
+};
+
+struct ipc_snapshot {
+  struct ipc_buffer data;
+  /* value of the query's generation the data was built from */
+  uint64_t generation;
+};
+
+struct ipc_client {
+  struct wl_list link;
+  int fd;
+  struct wl_event_source *source;
+
+  bool subscribed;
+  /* id of the subscribe request, events are sent with it */
+  uint32_t subscription_id;
+  /* mask of 1 << enum ipc_event the client subscribed to */
+  uint32_t events;
+  /* set when the client sent garbage, it is closed once the error is out */
+  bool close_when_flushed;
+
+  /* what was read so far, may end with a partial request */
+  char request[IPC_MAX_REQUEST];
+  size_t request_len;
+
+  /* data that did not fit into the socket yet, starting at queue_start */
+  struct ipc_buffer queue;
+  size_t queue_start;
+};
+
 void
 ipc_broadcast_message(enum ipc_event event);
 
-void *
-ipc_run(void *args);
+void
+ipc_invalidate(enum ipc_query query);
+
+struct mwc_toplevel;
+struct mwc_output;
+struct mwc_workspace;
+
+void
+ipc_toplevel_map(struct mwc_toplevel *toplevel);
+
+void
+ipc_toplevel_unmap(struct mwc_toplevel *toplevel);
+
+void
+ipc_toplevel_changed(void);
+
+void
+ipc_output_add(struct mwc_output *output);
+
+void
+ipc_output_remove(struct mwc_output *output);
+
+void
+ipc_workspace_output(struct mwc_workspace *workspace);
+
+bool
+ipc_init(void);
+
+void
+ipc_finish(void);
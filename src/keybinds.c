@@ -4,13 +4,16 @@
 
 #include "config.h"
 #include "helpers.h"
+#include "ipc.h"
 #include "mwc.h"
 #include "toplevel.h"
 #include "workspace.h"
 #include "layout.h"
+#include "pointer.h"
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wayland-util.h>
 #include <wlr/backend/session.h>
@@ -24,6 +27,10 @@ server_handle_keybinds(struct mwc_keyboard *keyboard, uint32_t keycode,
                        enum wl_keyboard_key_state state) {
   if(server.lock != NULL) return false;
 
+  /* most actions work on the focused toplevel, which might still be
+   * waiting for the pointer motion of this frame */
+  cursor_flush_motion();
+
   uint32_t modifiers = wlr_keyboard_get_modifiers(keyboard->wlr_keyboard);
   /* we use empty state so we can get raw, unmodified key.
    * this is used becuase we already handle modifiers explicitly,
@@ -33,31 +40,100 @@ server_handle_keybinds(struct mwc_keyboard *keyboard, uint32_t keycode,
    * instead of
    *   alt+shift 3 <do_something> */
 
+  /* vt switching was already checked by the caller on the real state,
+   * the keysyms for it are never produced by the empty one */
   const xkb_keysym_t *syms;
   int count = xkb_state_key_get_syms(keyboard->empty, keycode, &syms);
 
-  bool handled = handle_change_vt_key(syms, count);
-  if(handled) return true;
+  struct keybind_table *table = &server.config->keybind_table;
+  for(size_t i = 0; i < count; i++) {
+    bool handled = state == WL_KEYBOARD_KEY_STATE_PRESSED
+      ? keybind_table_press(table, modifiers, syms[i])
+      : keybind_table_release(table, syms[i]);
+    if(handled) return true;
+  }
+
+  return false;
+}
+
+uint32_t
+keybind_table_index(struct keybind_table *table, uint32_t modifiers, uint32_t key) {
+  uint64_t combined = ((uint64_t)modifiers << 32) | key;
+  return (combined * 0x9e3779b97f4a7c15ull >> 32) & (table->cap - 1);
+}
+
+void
+keybind_table_build(struct keybind_table *table, struct wl_list *keybinds) {
+  size_t count = wl_list_length(keybinds);
+  table->cap = 16;
+  while(table->cap < count * 2) {
+    table->cap *= 2;
+  }
+  table->slots = calloc(table->cap, sizeof(*table->slots));
+  table->active_count = 0;
 
+  /* the list is walked in the same order as before, so the last defined
+   * keybind for a combination still wins */
   struct keybind *k;
-  for(size_t i = 0; i < count; i++) {
-    wl_list_for_each(k, &server.config->keybinds, link) {
-      if(!k->initialized) continue;
-
-      if(k->active && k->stop && syms[i] == k->key
-         && state == WL_KEYBOARD_KEY_STATE_RELEASED) {
-        k->active = false;
-        k->stop(k->args);
-        return true;
-      }
-
-      if(modifiers == k->modifiers && syms[i] == k->key
-         && state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-        k->active = true;
-        k->action(k->args);
-        return true;
-      }
+  wl_list_for_each(k, keybinds, link) {
+    uint32_t i = keybind_table_index(table, k->modifiers, k->key);
+    while(table->slots[i] != NULL) {
+      i = (i + 1) & (table->cap - 1);
+    }
+    table->slots[i] = k;
+  }
+}
+
+void
+keybind_table_finish(struct keybind_table *table) {
+  free(table->slots);
+  table->slots = NULL;
+  table->cap = 0;
+  table->active_count = 0;
+}
+
+struct keybind *
+keybind_table_find(struct keybind_table *table, uint32_t modifiers, uint32_t key) {
+  if(table->cap == 0) return NULL;
+
+  uint32_t i = keybind_table_index(table, modifiers, key);
+  while(table->slots[i] != NULL) {
+    struct keybind *k = table->slots[i];
+    /* workspace keybinds stay uninitialized until their workspace exists */
+    if(k->initialized && k->modifiers == modifiers && k->key == key) {
+      return k;
     }
+    i = (i + 1) & (table->cap - 1);
+  }
+
+  return NULL;
+}
+
+bool
+keybind_table_press(struct keybind_table *table, uint32_t modifiers, uint32_t key) {
+  struct keybind *k = keybind_table_find(table, modifiers, key);
+  if(k == NULL) return false;
+
+  if(k->stop != NULL && !k->active && table->active_count < KEYBIND_ACTIVE_MAX) {
+    table->active[table->active_count++] = k;
+  }
+  k->active = true;
+
+  /* the action might reload the config, so the table is not touched after it */
+  k->action(k->args);
+  return true;
+}
+
+bool
+keybind_table_release(struct keybind_table *table, uint32_t key) {
+  for(size_t i = 0; i < table->active_count; i++) {
+    struct keybind *k = table->active[i];
+    if(k->key != key) continue;
+
+    table->active[i] = table->active[--table->active_count];
+    k->active = false;
+    k->stop(k->args);
+    return true;
   }
 
   return false;
@@ -160,6 +236,7 @@ keybind_stop_resize_focused_toplevel(void *data) {
     wl_list_remove(&server.grabbed_toplevel->link);
     wl_list_insert(&primary_output->active_workspace->floating_toplevels,
                    &server.grabbed_toplevel->link);
+    ipc_invalidate(IPC_QUERY_TOPLEVELS);
   }
 
   server_reset_cursor_mode();
@@ -188,6 +265,7 @@ keybind_stop_move_focused_toplevel(void *data) {
     server.grabbed_toplevel->workspace = primary_output->active_workspace;
     wl_list_insert(&primary_output->active_workspace->floating_toplevels,
                    &server.grabbed_toplevel->link);
+    ipc_invalidate(IPC_QUERY_TOPLEVELS);
   }
 
   server_reset_cursor_mode();
@@ -240,7 +318,6 @@ keybind_move_focus(void *data) {
   }
 
   /* get the toplevels output */
-  struct mwc_workspace *workspace = toplevel->workspace;
   struct mwc_output *output = toplevel->workspace->output;
   struct mwc_output *relative_output =
     output_get_relative(toplevel->workspace->output, direction);
@@ -267,92 +344,18 @@ keybind_move_focus(void *data) {
     return;
   }
 
-  struct wl_list *next;
-  if(toplevel_is_master(toplevel)) {
-    switch(direction) {
-      case MWC_RIGHT: {
-        next = toplevel->link.next;
-        if(next == &workspace->masters) {
-          next = workspace->slaves.prev;
-          if(next == &workspace->slaves) {
-            if(relative_output != NULL) {
-              focus_output(relative_output, opposite_side);
-            }
-            return;
-          }
-        }
-        struct mwc_toplevel *t = wl_container_of(next, t, link);
-        focus_toplevel(t);
-        cursor_jump_focused_toplevel();
-        return;
-      }
-      case MWC_LEFT: {
-        next = toplevel->link.prev;
-        if(next == &workspace->masters) {
-          if(relative_output != NULL) {
-            focus_output(relative_output, opposite_side);
-          }
-          return;
-        }
-        struct mwc_toplevel *t = wl_container_of(next, t, link);
-        focus_toplevel(t);
-        cursor_jump_focused_toplevel();
-        return;
-      }
-      default: {
-        if(relative_output != NULL) {
-          focus_output(relative_output, opposite_side);
-        }
-        return;
-      }
+  struct mwc_toplevel *neighbor = layout_find_neighbor(toplevel, direction);
+  if(neighbor == NULL) {
+    if(relative_output != NULL) {
+      focus_output(relative_output, opposite_side);
     }
+    return;
   }
 
-  /* only case left is that the toplevel is a slave */
-  switch(direction) {
-    case MWC_LEFT: {
-      struct mwc_toplevel *last_master =
-        wl_container_of(workspace->masters.prev, last_master, link);
-      focus_toplevel(last_master);
-      cursor_jump_focused_toplevel();
-      return;
-    }
-    case MWC_RIGHT: {
-      if(relative_output != NULL) {
-        focus_output(relative_output, opposite_side);
-      }
-      return;
-    }
-    case MWC_UP: {
-      struct wl_list *above = toplevel->link.prev;
-      if(above == &workspace->slaves) {
-        if(relative_output != NULL) {
-          focus_output(relative_output, opposite_side);
-        }
-        return;
-      }
-      struct mwc_toplevel *t = wl_container_of(above, t, link);
-      focus_toplevel(t);
-      cursor_jump_focused_toplevel();
-      return;
-    }
-    case MWC_DOWN: {
-      struct wl_list *bellow = toplevel->link.next;
-      if(bellow == &workspace->slaves) {
-        if(relative_output != NULL) {
-          focus_output(relative_output, opposite_side);
-        }
-        return;
-      }
-      struct mwc_toplevel *t = wl_container_of(bellow, t, link);
-      focus_toplevel(t);
-      cursor_jump_focused_toplevel();
-      return;
-    }
-  }
+  focus_toplevel(neighbor);
+  cursor_jump_focused_toplevel();
 }
 
-
 void
 keybind_swap_focused_toplevel(void *data) {
   uint64_t direction = (uint64_t)data;
@@ -372,93 +375,16 @@ keybind_swap_focused_toplevel(void *data) {
     return;
   }
 
-  struct wl_list *next;
-  if(toplevel_is_master(toplevel)) {
-    switch(direction) {
-      case MWC_RIGHT: {
-        next = toplevel->link.next;
-        if(next == &workspace->masters) {
-          next = workspace->slaves.prev;
-          if(next == &workspace->slaves) {
-            if(relative_output != NULL
-               && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-              toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-            }
-            return;
-          }
-        }
-        struct mwc_toplevel *t = wl_container_of(next, t, link);
-        layout_swap_tiled_toplevels(toplevel, t);
-        return;
-      }
-      case MWC_LEFT: {
-        next = toplevel->link.prev;
-        if(next == &workspace->masters) {
-          if(relative_output != NULL
-             && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-            toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-          }
-          return;
-        }
-        struct mwc_toplevel *t = wl_container_of(next, t, link);
-        layout_swap_tiled_toplevels(t, toplevel);
-        return;
-      }
-      default: {
-        struct mwc_output *relative_output =
-          output_get_relative(workspace->output, direction);
-        if(relative_output != NULL
-           && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-          toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-        }
-        return;
-      }
+  struct mwc_toplevel *neighbor = layout_find_neighbor(toplevel, direction);
+  if(neighbor == NULL) {
+    if(relative_output != NULL
+       && relative_output->active_workspace->fullscreen_toplevel == NULL) {
+      toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
     }
+    return;
   }
 
-  switch(direction) {
-    case MWC_LEFT: {
-      struct mwc_toplevel *last_master =
-        wl_container_of(workspace->masters.prev, last_master, link);
-      layout_swap_tiled_toplevels(toplevel, last_master);
-      return;
-    }
-    case MWC_RIGHT: {
-      struct mwc_output *relative_output =
-        output_get_relative(workspace->output, direction);
-      if(relative_output != NULL
-         && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-        toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-      }
-      return;
-    }
-    case MWC_UP: {
-      next = toplevel->link.prev;
-      if(next == &workspace->slaves) {
-        if(relative_output != NULL
-           && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-          toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-        }
-        return;
-      }
-      struct mwc_toplevel *t = wl_container_of(next, t, link);
-      layout_swap_tiled_toplevels(t, toplevel);
-      return;
-    }
-    case MWC_DOWN: {
-      next = toplevel->link.next;
-      if(next == &workspace->slaves) {
-        if(relative_output != NULL
-           && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-          toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-        }
-        return;
-      }
-      struct mwc_toplevel *t = wl_container_of(next, t, link);
-      layout_swap_tiled_toplevels(toplevel, t);
-      return;
-    }
-  }
+  layout_swap_tiled_toplevels(toplevel, neighbor);
 }
 
 void
@@ -468,13 +394,9 @@ keybind_focused_toplevel_toggle_floating(void *data) {
 
   if(toplevel->floating) {
     toplevel->floating = false;
+    ipc_toplevel_changed();
     wl_list_remove(&toplevel->link);
-
-    if(wl_list_length(&toplevel->workspace->masters) < server.config->master_count) {
-      wl_list_insert(toplevel->workspace->masters.prev, &toplevel->link);
-    } else {
-      wl_list_insert(toplevel->workspace->slaves.prev, &toplevel->link);
-    }
+    layout_append(toplevel);
 
     wlr_scene_node_reparent(&toplevel->scene_tree->node, server.tiled_tree);
     wlr_scene_node_raise_to_top(&toplevel->scene_tree->node);
@@ -484,18 +406,15 @@ keybind_focused_toplevel_toggle_floating(void *data) {
   }
 
   toplevel->floating = true;
-  if(toplevel_is_master(toplevel)) {
-    if(!wl_list_empty(&toplevel->workspace->slaves)) {
-      struct mwc_toplevel *s = wl_container_of(toplevel->workspace->slaves.prev, s, link);
-      wl_list_remove(&s->link);
-      wl_list_insert(toplevel->workspace->masters.prev, &s->link);
-    }
-    wl_list_remove(&toplevel->link);
-  } else {
-    wl_list_remove(&toplevel->link);
+  ipc_toplevel_changed();
+  if(toplevel_is_master(toplevel) && toplevel->workspace->slave_count > 0) {
+    struct mwc_toplevel *s = wl_container_of(toplevel->workspace->slaves.prev, s, link);
+    layout_promote_slave(s);
   }
+  layout_remove(toplevel);
 
   wl_list_insert(&toplevel->workspace->floating_toplevels, &toplevel->link);
+  ipc_invalidate(IPC_QUERY_TOPLEVELS);
 
   uint32_t width, height;
   toplevel_floating_size(toplevel, &width, &height);
@@ -521,5 +440,13 @@ keybind_focused_toplevel_toggle_fullscreen(void *data) {
 
 void
 keybind_reload_config(void *data) {
-  config_reload();
+  /* parsed on the parser thread like a save, so a slow config does not stall the loop */
+  config_request_parse();
+}
+
+void
+keybind_set_layout(void *data) {
+  struct mwc_workspace *workspace = server.active_workspace;
+  workspace->layout = data;
+  layout_set_pending_state(workspace);
 }
@@ -2,10 +2,14 @@
 
 #include "keyboard.h"
 
+#include <stddef.h>
 #include <wayland-server-core.h>
 
 typedef void (*keybind_action_func_t)(void *);
 
+/* keybinds with a stop action that can be held down at the same time */
+#define KEYBIND_ACTIVE_MAX 16
+
 struct keybind {
   bool initialized;
   uint32_t modifiers;
@@ -17,6 +21,35 @@ struct keybind {
   struct wl_list link;
 };
 
+/* open addressing table keyed by (modifiers, key), built once per config.
+ * keybinds for the same combination are all kept, in the order of the list */
+struct keybind_table {
+  struct keybind **slots;
+  /* power of two, at least twice the number of keybinds */
+  size_t cap;
+  /* pressed keybinds waiting for the release of their key to call stop */
+  struct keybind *active[KEYBIND_ACTIVE_MAX];
+  size_t active_count;
+};
+
+uint32_t
+keybind_table_index(struct keybind_table *table, uint32_t modifiers, uint32_t key);
+
+void
+keybind_table_build(struct keybind_table *table, struct wl_list *keybinds);
+
+void
+keybind_table_finish(struct keybind_table *table);
+
+struct keybind *
+keybind_table_find(struct keybind_table *table, uint32_t modifiers, uint32_t key);
+
+bool
+keybind_table_press(struct keybind_table *table, uint32_t modifiers, uint32_t key);
+
+bool
+keybind_table_release(struct keybind_table *table, uint32_t key);
+
 bool
 server_handle_keybinds(struct mwc_keyboard *keyboard,
                        uint32_t keycode,
@@ -75,3 +108,6 @@ keybind_focused_toplevel_toggle_fullscreen(void *data);
 
 void
 keybind_reload_config(void *data);
+
+void
+keybind_set_layout(void *data);
@@ -4,6 +4,7 @@
 #include "layer_surface.h"
 
 #include "config.h"
+#include "ipc.h"
 #include "mwc.h"
 #include "popup.h"
 #include "output.h"
@@ -55,8 +56,11 @@ server_handle_new_layer_surface(struct wl_listener *listener, void *data) {
 
   struct wl_list *list = layer_get_list(output, layer);
   wl_list_insert(list, &layer_surface->link);
+  ipc_invalidate(IPC_QUERY_LAYERS);
 
   layer_surface->scene->tree->node.data = &layer_surface->something;
+  spatial_entry_init(&layer_surface->spatial, &layer_surface->something,
+                     &layer_surface->scene->tree->node);
 
   layer_surface->commit.notify = layer_surface_handle_commit;
   wl_signal_add(&wlr_layer_surface->surface->events.commit, &layer_surface->commit);
@@ -80,6 +84,8 @@ layer_surface_handle_commit(struct wl_listener *listener, void *data) {
 
   if(!layer_surface->wlr_layer_surface->initialized) return;
 
+  spatial_entry_mark_dirty(&layer_surface->spatial);
+
   struct mwc_output *output = layer_surface->wlr_layer_surface->output->data;
 
   uint32_t committed = layer_surface->wlr_layer_surface->current.committed;
@@ -89,6 +95,7 @@ layer_surface_handle_commit(struct wl_listener *listener, void *data) {
 		struct wl_list *list = layer_get_list(output, layer);
     wl_list_remove(&layer_surface->link);
     wl_list_insert(list, &layer_surface->link);
+    ipc_invalidate(IPC_QUERY_LAYERS);
 
 		struct wlr_scene_tree *scene = layer_get_scene(layer);
 		wlr_scene_node_reparent(&layer_surface->scene->tree->node, scene);
@@ -133,6 +140,7 @@ layer_surface_handle_map(struct wl_listener *listener, void *data) {
   wlr_output_layout_get_box(server.output_layout, output->wlr_output, &output_box);
 
   wlr_scene_layer_surface_v1_configure(layer_surface->scene, &output_box, &output->usable_area);
+  spatial_entry_mark_dirty(&layer_surface->spatial);
 
   layout_set_pending_state(output->active_workspace);
 
@@ -144,6 +152,7 @@ layer_surface_handle_unmap(struct wl_listener *listener, void *data) {
   struct mwc_layer_surface *layer_surface = wl_container_of(listener, layer_surface, unmap);
 
   wl_list_remove(&layer_surface->link);
+  ipc_invalidate(IPC_QUERY_LAYERS);
 
   struct mwc_output *output = layer_surface->wlr_layer_surface->output->data;
 
@@ -202,6 +211,7 @@ layer_surface_handle_destroy(struct wl_listener *listener, void *data) {
   wl_list_remove(&layer_surface->map.link);
   wl_list_remove(&layer_surface->unmap.link);
   wl_list_remove(&layer_surface->destroy.link);
+  spatial_entry_finish(&layer_surface->spatial);
 
   free(layer_surface);
 }
@@ -265,6 +275,7 @@ layer_surfaces_commit_layer(struct mwc_output *output,
 		if((l->wlr_layer_surface->current.exclusive_zone > 0) != exclusive) continue;
 
 		wlr_scene_layer_surface_v1_configure(l->scene, &full_area, &output->usable_area);
+    spatial_entry_mark_dirty(&l->spatial);
 	}
 }
 
@@ -2,6 +2,7 @@
 
 #include "output.h"
 #include "something.h"
+#include "spatial.h"
 
 #include <stdbool.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
@@ -12,6 +13,7 @@ struct mwc_layer_surface {
   struct wlr_scene_layer_surface_v1 *scene;
 
   struct mwc_something something;
+  struct spatial_entry spatial;
 
   struct wl_listener map;
   struct wl_listener unmap;
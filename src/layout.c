@@ -1,78 +1,355 @@
 #include "layout.h"
 
 #include "mwc.h"
+#include "array.h"
 #include "config.h"
+#include "ipc.h"
+#include "something.h"
+#include "spatial.h"
 #include "toplevel.h"
+#include "transaction.h"
+#include "workspace.h"
 #include "wlr/util/box.h"
 
+#include <limits.h>
+#include <math.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <wayland-util.h>
 #include <wlr/types/wlr_scene.h>
 
 extern struct mwc_server server;
 
+const struct mwc_layout layouts[LAYOUT_COUNT] = {
+  {
+    .name = "master-stack",
+    .arrange = master_stack_arrange,
+    .neighbor = master_stack_neighbor,
+    .closest = master_stack_closest,
+  },
+  {
+    .name = "centered-master",
+    .arrange = centered_master_arrange,
+  },
+  {
+    .name = "grid",
+    .arrange = grid_arrange,
+  },
+  {
+    .name = "monocle",
+    .arrange = monocle_arrange,
+    .neighbor = monocle_neighbor,
+  },
+  {
+    .name = "bsp",
+    .arrange = bsp_arrange,
+  },
+};
+
+const struct mwc_layout *
+layout_from_name(char *name) {
+  for(size_t i = 0; i < LAYOUT_COUNT; i++) {
+    if(strcmp(layouts[i].name, name) == 0) return &layouts[i];
+  }
+  return NULL;
+}
+
+/* i-th of count equal parts of region with inner gaps between them,
+ * the last one gets what is left after rounding */
+struct wlr_box
+layout_split_at(struct wlr_box *region, uint32_t count, uint32_t i, bool horizontal) {
+  int32_t gap = 2 * server.config->inner_gaps;
+  struct wlr_box box = *region;
+
+  if(horizontal) {
+    int32_t size = (region->width - gap * ((int32_t)count - 1)) / (int32_t)count;
+    box.x = region->x + (size + gap) * (int32_t)i;
+    box.width = i == count - 1 ? region->x + region->width - box.x : size;
+  } else {
+    int32_t size = (region->height - gap * ((int32_t)count - 1)) / (int32_t)count;
+    box.y = region->y + (size + gap) * (int32_t)i;
+    box.height = i == count - 1 ? region->y + region->height - box.y : size;
+  }
+
+  return box;
+}
+
 void
-calculate_masters_dimensions(struct mwc_output *output, uint32_t master_count,
-                             uint32_t slave_count, uint32_t *width, uint32_t *height) {
-  uint32_t outer_gaps = server.config->outer_gaps;
-  uint32_t inner_gaps = server.config->inner_gaps;
+layout_split(struct wlr_box *region, uint32_t count, bool horizontal, struct wlr_box *boxes) {
+  for(uint32_t i = 0; i < count; i++) {
+    boxes[i] = layout_split_at(region, count, i, horizontal);
+  }
+}
+
+/* like layout_split(), but the last one does not get what the division leaves over */
+void
+layout_split_even(struct wlr_box *region, uint32_t count, bool horizontal, struct wlr_box *boxes) {
+  layout_split(region, count, horizontal, boxes);
+
+  if(horizontal) {
+    boxes[count - 1].width = boxes[0].width;
+  } else {
+    boxes[count - 1].height = boxes[0].height;
+  }
+}
+
+/* masters side by side on the left, slaves stacked on the right. the ratio is
+ * taken of the width with the outer gaps and the tiles are all the same size,
+ * so it comes out to the pixel the way it always did */
+void
+master_stack_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+                     struct wlr_box *boxes) {
+  uint32_t slave_count = count - master_count;
+  if(slave_count == 0) {
+    layout_split_even(area, count, true, boxes);
+    return;
+  }
+
+  int32_t gap = server.config->inner_gaps;
+  int32_t outer_gaps = server.config->outer_gaps;
+  int32_t border_width = server.config->border_width;
   double master_ratio = server.config->master_ratio;
-  double border_width = server.config->border_width;
+  int32_t x = area->x - outer_gaps;
+  int32_t width = area->width + 2 * outer_gaps;
+  int32_t split = (int32_t)(width * master_ratio) - outer_gaps;
+
+  struct wlr_box masters = {
+    .x = area->x,
+    .y = area->y,
+    .width = split - gap,
+    .height = area->height,
+  };
+  /* rounded the same way as when the border was part of the sum */
+  struct wlr_box slaves = {
+    .x = (int32_t)(x + width * master_ratio + gap + border_width) - border_width,
+    .y = area->y,
+    .width = (int32_t)(width * (1 - master_ratio)) - outer_gaps - gap,
+    .height = area->height,
+  };
 
-  struct wlr_box output_box = output->usable_area;
+  layout_split_even(&masters, master_count, true, boxes);
+  layout_split_even(&slaves, slave_count, false, boxes + master_count);
+}
 
-  uint32_t total_width = slave_count > 0
-    ? output_box.width * master_ratio
-    : output_box.width;
+/* masters in the middle, slaves stacked on both sides, first ones on the right */
+void
+centered_master_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+                        struct wlr_box *boxes) {
+  uint32_t slave_count = count - master_count;
+  if(slave_count < 2) {
+    master_stack_arrange(area, count, master_count, boxes);
+    return;
+  }
+
+  int32_t gap = server.config->inner_gaps;
+  int32_t center = area->width * server.config->master_ratio;
+  int32_t side = (area->width - center) / 2;
+
+  struct wlr_box left = {
+    .x = area->x,
+    .y = area->y,
+    .width = side - gap,
+    .height = area->height,
+  };
+  struct wlr_box masters = {
+    .x = area->x + side + gap,
+    .y = area->y,
+    .width = center - 2 * gap,
+    .height = area->height,
+  };
+  struct wlr_box right = {
+    .x = area->x + side + center + gap,
+    .y = area->y,
+    .width = area->x + area->width - (area->x + side + center + gap),
+    .height = area->height,
+  };
 
-  uint32_t total_decorations = slave_count > 0
-    ? outer_gaps // left outer gaps
-      + master_count * 2 * border_width // all borders
-      + (master_count - 1) * 2 * inner_gaps // inner gaps between masters
-      + inner_gaps // right inner gaps 
-    : outer_gaps // left outer gaps
-      + master_count * 2 * border_width // all borders
-      + (master_count - 1) * 2 * inner_gaps // inner gaps between masters
-      + outer_gaps; // right outer gaps
+  uint32_t right_count = (slave_count + 1) / 2;
+  layout_split(&masters, master_count, true, boxes);
+  layout_split(&right, right_count, false, boxes + master_count);
+  layout_split(&left, slave_count - right_count, false, boxes + master_count + right_count);
+}
 
-  *width = (total_width - total_decorations) / master_count;
-  *height = output_box.height - 2 * outer_gaps - 2 * border_width;
+/* rows of equal cells, the last row stretches if it is not full */
+void
+grid_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+             struct wlr_box *boxes) {
+  uint32_t columns = ceil(sqrt(count));
+  uint32_t rows = (count + columns - 1) / columns;
+
+  for(uint32_t row = 0; row < rows; row++) {
+    struct wlr_box row_box = layout_split_at(area, rows, row, false);
+    uint32_t first = row * columns;
+    uint32_t in_row = count - first < columns ? count - first : columns;
+    layout_split(&row_box, in_row, true, boxes + first);
+  }
 }
 
+/* everything takes the whole area, the focused one is on top */
 void
-calculate_slaves_dimensions(struct mwc_output *output, uint32_t slave_count,
-                            uint32_t *width, uint32_t *height) {
-  uint32_t outer_gaps = server.config->outer_gaps;
-  uint32_t inner_gaps = server.config->inner_gaps;
-  double master_ratio = server.config->master_ratio;
-  double border_width = server.config->border_width;
+monocle_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+                struct wlr_box *boxes) {
+  for(uint32_t i = 0; i < count; i++) {
+    boxes[i] = *area;
+  }
+}
 
-  struct wlr_box output_box = output->usable_area;
+/* every toplevel takes half of what is left, splitting along the longer side */
+void
+bsp_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+            struct wlr_box *boxes) {
+  struct wlr_box region = *area;
+
+  for(uint32_t i = 0; i < count - 1; i++) {
+    bool horizontal = region.width >= region.height;
+    boxes[i] = layout_split_at(&region, 2, 0, horizontal);
+    region = layout_split_at(&region, 2, 1, horizontal);
+  }
 
-  *width = output_box.width * (1 - master_ratio)
-    - outer_gaps - inner_gaps
-    - 2 * border_width;
-  *height = (output_box.height - 2 * outer_gaps
-    - (slave_count - 1) * 2 * inner_gaps
-    - slave_count * 2 * border_width) / slave_count;
+  boxes[count - 1] = region;
 }
 
 bool
 toplevel_is_master(struct mwc_toplevel *toplevel) {
-  struct mwc_toplevel *t;
-  wl_list_for_each(t, &toplevel->workspace->masters, link) {
-    if(toplevel == t) return true;
-  };
-  return false;
+  return toplevel->layout_role == MWC_LAYOUT_MASTER;
 }
 
 bool
 toplevel_is_slave(struct mwc_toplevel *toplevel) {
-  struct mwc_toplevel *t;
-  wl_list_for_each(t, &toplevel->workspace->slaves, link) {
-    if(toplevel == t) return true;
+  return toplevel->layout_role == MWC_LAYOUT_SLAVE;
+}
+
+void
+layout_insert(struct mwc_toplevel *toplevel, enum mwc_layout_role role, struct wl_list *prev) {
+  struct mwc_workspace *workspace = toplevel->workspace;
+
+  wl_list_insert(prev, &toplevel->link);
+  toplevel->layout_role = role;
+  ipc_invalidate(IPC_QUERY_TOPLEVELS);
+  if(role == MWC_LAYOUT_MASTER) {
+    workspace->master_count++;
+  } else {
+    workspace->slave_count++;
+  }
+}
+
+void
+layout_append(struct mwc_toplevel *toplevel) {
+  struct mwc_workspace *workspace = toplevel->workspace;
+
+  if(workspace->master_count < server.config->master_count) {
+    layout_insert(toplevel, MWC_LAYOUT_MASTER, workspace->masters.prev);
+  } else {
+    layout_insert(toplevel, MWC_LAYOUT_SLAVE, workspace->slaves.prev);
+  }
+}
+
+void
+layout_remove(struct mwc_toplevel *toplevel) {
+  struct mwc_workspace *workspace = toplevel->workspace;
+
+  transaction_remove_toplevel(toplevel);
+
+  wl_list_remove(&toplevel->link);
+  if(toplevel->layout_role == MWC_LAYOUT_MASTER) {
+    workspace->master_count--;
+  } else {
+    workspace->slave_count--;
+  }
+  toplevel->layout_role = MWC_LAYOUT_NONE;
+  spatial_entry_set_slot(&toplevel->spatial, (struct wlr_box){0});
+  ipc_invalidate(IPC_QUERY_TOPLEVELS);
+}
+
+/* these two stay on the same workspace, so unlike layout_remove()
+ * they keep the toplevel in its transaction */
+void
+layout_promote_slave(struct mwc_toplevel *slave) {
+  wl_list_remove(&slave->link);
+  slave->workspace->slave_count--;
+  layout_insert(slave, MWC_LAYOUT_MASTER, slave->workspace->masters.prev);
+}
+
+void
+layout_demote_last_master(struct mwc_workspace *workspace) {
+  struct mwc_toplevel *last = wl_container_of(workspace->masters.prev, last, link);
+  wl_list_remove(&last->link);
+  workspace->master_count--;
+  layout_insert(last, MWC_LAYOUT_SLAVE, workspace->slaves.prev);
+}
+
+struct mwc_toplevel *
+layout_first_tiled(struct mwc_workspace *workspace) {
+  if(wl_list_empty(&workspace->masters)) return NULL;
+
+  struct mwc_toplevel *t = wl_container_of(workspace->masters.next, t, link);
+  return t;
+}
+
+/* tiled toplevels are ordered masters first, then slaves */
+struct mwc_toplevel *
+layout_next_tiled(struct mwc_toplevel *toplevel) {
+  struct mwc_workspace *workspace = toplevel->workspace;
+
+  struct wl_list *next = toplevel->link.next;
+  if(next == &workspace->masters) {
+    next = workspace->slaves.next;
+  }
+  if(next == &workspace->slaves) return NULL;
+
+  struct mwc_toplevel *t = wl_container_of(next, t, link);
+  return t;
+}
+
+struct mwc_toplevel *
+layout_prev_tiled(struct mwc_toplevel *toplevel) {
+  struct mwc_workspace *workspace = toplevel->workspace;
+
+  struct wl_list *prev = toplevel->link.prev;
+  if(prev == &workspace->slaves) {
+    prev = workspace->masters.prev;
+  }
+  if(prev == &workspace->masters) return NULL;
+
+  struct mwc_toplevel *t = wl_container_of(prev, t, link);
+  return t;
+}
+
+void
+layout_arrange(struct mwc_workspace *workspace, uint32_t count, uint32_t master_count,
+               struct wlr_box *boxes) {
+  if(count == 0) return;
+
+  struct wlr_box usable = workspace->output->usable_area;
+  int32_t outer_gaps = server.config->outer_gaps;
+
+  struct wlr_box area = {
+    .x = usable.x + outer_gaps,
+    .y = usable.y + outer_gaps,
+    .width = usable.width - 2 * outer_gaps,
+    .height = usable.height - 2 * outer_gaps,
+  };
+
+  workspace->layout->arrange(&area, count, master_count, boxes);
+}
+
+/* tiles include the borders, toplevels dont */
+struct wlr_box
+layout_tile_to_geometry(struct wlr_box *tile) {
+  int32_t border_width = server.config->border_width;
+
+  struct wlr_box box = {
+    .x = tile->x + border_width,
+    .y = tile->y + border_width,
+    .width = tile->width - 2 * border_width,
+    .height = tile->height - 2 * border_width,
   };
-  return false;
+
+  if(box.width < 1) box.width = 1;
+  if(box.height < 1) box.height = 1;
+
+  return box;
 }
 
 void
@@ -85,71 +362,206 @@ layout_set_pending_state(struct mwc_workspace *workspace) {
 
   struct mwc_output *output = workspace->output;
 
-  uint32_t outer_gaps = server.config->outer_gaps;
-  uint32_t inner_gaps = server.config->inner_gaps;
-  double master_ratio = server.config->master_ratio;
-  double border_width = server.config->border_width;
-
-  uint32_t slave_count = wl_list_length(&workspace->slaves);
-  uint32_t master_count = wl_list_length(&workspace->masters);
-
-  uint32_t master_width, master_height;
-  calculate_masters_dimensions(output, master_count, slave_count,
-                               &master_width, &master_height);
-
-  struct mwc_toplevel *m;
-  size_t i = 0;
-  wl_list_for_each(m, &workspace->masters, link) {
-    uint32_t master_x = output->usable_area.x + outer_gaps
-      + (master_width + 2 * border_width) * i
-      + 2 * inner_gaps * i
-      + border_width;
-    uint32_t master_y = output->usable_area.y + outer_gaps
-      + border_width;
-
-    toplevel_set_pending_state(m, master_x, master_y, master_width, master_height);
+  /* the whole layout is computed in one pass and kept for hit testing and navigation */
+  uint32_t count = workspace->master_count + workspace->slave_count;
+  while(array_len(workspace->tiles) < count) {
+    array_push(&workspace->tiles, (struct wlr_box){0});
+  }
+  array_len(workspace->tiles) = count;
+  layout_arrange(workspace, count, workspace->master_count, workspace->tiles);
+
+  /* every toplevel that moves schedules a frame, we want just one */
+  output->defer_frames = true;
+  /* new geometry is held back until all the clients are ready for it */
+  transaction_begin(workspace);
+
+  uint32_t i = 0;
+  for(struct mwc_toplevel *t = layout_first_tiled(workspace); t != NULL;
+      t = layout_next_tiled(t)) {
+    struct wlr_box box = layout_tile_to_geometry(&workspace->tiles[i]);
+    t->layout_index = i;
+    spatial_entry_set_slot(&t->spatial, layout_tile_slot(workspace, &workspace->tiles[i]));
+    toplevel_set_pending_state(t, box.x, box.y, box.width, box.height);
     i++;
   }
 
-  if(slave_count == 0) return;
+  output->defer_frames = false;
+  if(output->frame_deferred) {
+    output->frame_deferred = false;
+    wlr_output_schedule_frame(output->wlr_output);
+  }
+
+  transaction_end(workspace);
+}
+
+void
+layout_predict_size(struct mwc_workspace *workspace, uint32_t *width, uint32_t *height) {
+  uint32_t count = workspace->master_count + workspace->slave_count + 1;
+  bool master = workspace->master_count < server.config->master_count;
+  uint32_t master_count = master ? workspace->master_count + 1 : workspace->master_count;
 
-  /* share the remaining space among slaves */
-  uint32_t slave_width, slave_height, slave_x, slave_y;
-  calculate_slaves_dimensions(workspace->output, slave_count, &slave_width, &slave_height);
+  /* scratch space, the tiles of the workspace are still in use */
+  struct wlr_box *boxes = calloc(count, sizeof(*boxes));
+  layout_arrange(workspace, count, master_count, boxes);
 
-  struct mwc_toplevel *s;
-  i = 0;
-  wl_list_for_each(s, &workspace->slaves, link) {
-    slave_x = output->usable_area.x + output->usable_area.width * master_ratio
-      + inner_gaps + border_width;
-    slave_y = output->usable_area.y + outer_gaps
-      + i * (slave_height + inner_gaps * 2 + 2 * border_width)
-      + border_width;
+  /* see layout_append() */
+  struct wlr_box box = layout_tile_to_geometry(&boxes[master ? master_count - 1 : count - 1]);
+  *width = box.width;
+  *height = box.height;
 
-    toplevel_set_pending_state(s, slave_x, slave_y, slave_width, slave_height);
-    i++;
-  }
+  free(boxes);
 }
 
-/* this function assumes they are in the same workspace and
- * that t2 comes after t1 if in the same list */
 void
 layout_swap_tiled_toplevels(struct mwc_toplevel *t1, struct mwc_toplevel *t2) {
+  /* the list juggling below needs t1 to come first */
+  if(t1->layout_index > t2->layout_index) {
+    struct mwc_toplevel *temp = t1;
+    t1 = t2;
+    t2 = temp;
+  }
+
   struct wl_list *before_t1 = t1->link.prev;
   wl_list_remove(&t1->link);
   wl_list_insert(&t2->link, &t1->link);
   wl_list_remove(&t2->link);
   wl_list_insert(before_t1, &t2->link);
+  ipc_invalidate(IPC_QUERY_TOPLEVELS);
+
+  /* they might have been in different lists, the counts stay the same */
+  enum mwc_layout_role t1_role = t1->layout_role;
+  t1->layout_role = t2->layout_role;
+  t2->layout_role = t1_role;
 
   layout_set_pending_state(t1->workspace);
 }
 
 struct mwc_toplevel *
-layout_find_closest_tiled_toplevel(struct mwc_workspace *workspace, bool master,
-                                   enum mwc_direction side) {
-  /* this means there are no tiled toplevels */
-  if(wl_list_empty(&workspace->masters)) return NULL;
+master_stack_neighbor(struct mwc_toplevel *toplevel, enum mwc_direction direction) {
+  struct mwc_workspace *workspace = toplevel->workspace;
+
+  struct wl_list *next = NULL;
+  if(toplevel_is_master(toplevel)) {
+    switch(direction) {
+      case MWC_RIGHT: {
+        next = toplevel->link.next;
+        if(next == &workspace->masters) {
+          next = workspace->slaves.prev;
+          if(next == &workspace->slaves) return NULL;
+        }
+        break;
+      }
+      case MWC_LEFT: {
+        next = toplevel->link.prev;
+        if(next == &workspace->masters) return NULL;
+        break;
+      }
+      default: {
+        return NULL;
+      }
+    }
+  } else {
+    switch(direction) {
+      case MWC_LEFT: {
+        next = workspace->masters.prev;
+        break;
+      }
+      case MWC_RIGHT: {
+        return NULL;
+      }
+      case MWC_UP: {
+        next = toplevel->link.prev;
+        if(next == &workspace->slaves) return NULL;
+        break;
+      }
+      case MWC_DOWN: {
+        next = toplevel->link.next;
+        if(next == &workspace->slaves) return NULL;
+        break;
+      }
+    }
+  }
+
+  struct mwc_toplevel *t = wl_container_of(next, t, link);
+  return t;
+}
+
+/* they are all on top of each other, so we just go through them in order */
+struct mwc_toplevel *
+monocle_neighbor(struct mwc_toplevel *toplevel, enum mwc_direction direction) {
+  if(direction == MWC_LEFT || direction == MWC_UP) {
+    return layout_prev_tiled(toplevel);
+  }
+  return layout_next_tiled(toplevel);
+}
+
+/* the closest tile in the direction, preferring the ones that line up with this one */
+struct mwc_toplevel *
+layout_find_neighbor_geometric(struct mwc_toplevel *toplevel, enum mwc_direction direction) {
+  struct mwc_workspace *workspace = toplevel->workspace;
+  size_t tile_count = array_len(workspace->tiles);
+  if(toplevel->layout_index >= tile_count) return NULL;
+
+  struct wlr_box *from = &workspace->tiles[toplevel->layout_index];
+
+  struct mwc_toplevel *best = NULL;
+  uint64_t best_score = UINT64_MAX;
+  for(struct mwc_toplevel *t = layout_first_tiled(workspace); t != NULL;
+      t = layout_next_tiled(t)) {
+    if(t == toplevel || t->layout_index >= tile_count) continue;
+
+    struct wlr_box *to = &workspace->tiles[t->layout_index];
+
+    int32_t distance;
+    /* how far apart they are on the other axis, 0 if they overlap */
+    int32_t offset;
+    switch(direction) {
+      case MWC_RIGHT:
+      case MWC_LEFT: {
+        distance = direction == MWC_RIGHT
+          ? to->x - (from->x + from->width)
+          : from->x - (to->x + to->width);
+        offset = to->y >= from->y + from->height ? to->y - (from->y + from->height)
+          : from->y >= to->y + to->height ? from->y - (to->y + to->height)
+          : 0;
+        break;
+      }
+      case MWC_DOWN:
+      case MWC_UP: {
+        distance = direction == MWC_DOWN
+          ? to->y - (from->y + from->height)
+          : from->y - (to->y + to->height);
+        offset = to->x >= from->x + from->width ? to->x - (from->x + from->width)
+          : from->x >= to->x + to->width ? from->x - (to->x + to->width)
+          : 0;
+        break;
+      }
+    }
+
+    if(distance < 0) continue;
+
+    uint64_t score = ((uint64_t)offset << 32) | (uint32_t)distance;
+    if(score < best_score) {
+      best_score = score;
+      best = t;
+    }
+  }
 
+  return best;
+}
+
+struct mwc_toplevel *
+layout_find_neighbor(struct mwc_toplevel *toplevel, enum mwc_direction direction) {
+  if(toplevel->workspace->layout->neighbor != NULL) {
+    return toplevel->workspace->layout->neighbor(toplevel, direction);
+  }
+
+  return layout_find_neighbor_geometric(toplevel, direction);
+}
+
+struct mwc_toplevel *
+master_stack_closest(struct mwc_workspace *workspace, bool master,
+                     enum mwc_direction side) {
   struct mwc_toplevel *first_master = wl_container_of(workspace->masters.next,
                                                       first_master, link);
   struct mwc_toplevel *last_master = wl_container_of(workspace->masters.prev,
@@ -182,57 +594,92 @@ layout_find_closest_tiled_toplevel(struct mwc_workspace *workspace, bool master,
 }
 
 struct mwc_toplevel *
-layout_toplevel_at(struct mwc_workspace *workspace, uint32_t x, uint32_t y) {
-  struct mwc_toplevel *t;
-  wl_list_for_each(t, &workspace->masters, link) {
-    uint32_t decorations_left = t->link.prev == &workspace->masters
-      ? server.config->outer_gaps + server.config->border_width
-      : server.config->inner_gaps + server.config->border_width;
-
-    uint32_t decorations_right = wl_list_empty(&workspace->slaves) 
-      ? server.config->outer_gaps + server.config->border_width
-      : server.config->inner_gaps + server.config->border_width;
-
-    uint32_t decorations_top = server.config->outer_gaps + server.config->border_width;
+layout_find_closest_tiled_toplevel(struct mwc_workspace *workspace, bool master,
+                                   enum mwc_direction side) {
+  /* this means there are no tiled toplevels */
+  if(wl_list_empty(&workspace->masters)) return NULL;
 
-    uint32_t decorations_bottom = server.config->outer_gaps + server.config->border_width;
+  if(workspace->layout->closest != NULL) {
+    return workspace->layout->closest(workspace, master, side);
+  }
 
-    struct wlr_box box = {
-      .x = t->current.x - decorations_left,
-      .y = t->current.y - decorations_top,
-      .width = t->current.width + decorations_left + decorations_right + 1,
-      .height = t->current.height + decorations_top + decorations_bottom + 1,
-    };
+  /* the one furthest to the side, first one wins */
+  size_t tile_count = array_len(workspace->tiles);
+  struct mwc_toplevel *best = NULL;
+  int32_t best_edge = 0;
+  for(struct mwc_toplevel *t = layout_first_tiled(workspace); t != NULL;
+      t = layout_next_tiled(t)) {
+    if(t->layout_index >= tile_count) continue;
+
+    struct wlr_box *tile = &workspace->tiles[t->layout_index];
+    int32_t edge;
+    switch(side) {
+      case MWC_LEFT: edge = -tile->x; break;
+      case MWC_RIGHT: edge = tile->x + tile->width; break;
+      case MWC_UP: edge = -tile->y; break;
+      case MWC_DOWN: edge = tile->y + tile->height; break;
+    }
 
-    if(wlr_box_contains_point(&box, x, y)) {
-      return t;
+    if(best == NULL || edge > best_edge) {
+      best = t;
+      best_edge = edge;
     }
   }
 
-  wl_list_for_each(t, &workspace->slaves, link) {
-    uint32_t decorations_left = server.config->inner_gaps + server.config->border_width;
-    uint32_t decorations_right = server.config->outer_gaps + server.config->border_width;
-
-    uint32_t decorations_top = t->link.prev == &workspace->slaves
-      ? server.config->outer_gaps + server.config->border_width
-      : server.config->inner_gaps + server.config->border_width;
+  return best;
+}
 
-    uint32_t decorations_bottom = t->link.next == &workspace->slaves
-      ? server.config->outer_gaps + server.config->border_width
-      : server.config->inner_gaps + server.config->border_width;
+/* tiles are grown by half of the gaps between them so they meet,
+ * and the ones on the edges also take the outer gaps */
+struct wlr_box
+layout_tile_slot(struct mwc_workspace *workspace, struct wlr_box *tile) {
+  struct wlr_box usable = workspace->output->usable_area;
+  int32_t inner_gaps = server.config->inner_gaps;
+
+  int32_t left = tile->x - inner_gaps;
+  int32_t top = tile->y - inner_gaps;
+  int32_t right = tile->x + tile->width + inner_gaps;
+  int32_t bottom = tile->y + tile->height + inner_gaps;
+
+  if(left <= usable.x + (int32_t)server.config->outer_gaps) left = usable.x;
+  if(top <= usable.y + (int32_t)server.config->outer_gaps) top = usable.y;
+  if(right >= usable.x + usable.width - (int32_t)server.config->outer_gaps) {
+    right = usable.x + usable.width;
+  }
+  if(bottom >= usable.y + usable.height - (int32_t)server.config->outer_gaps) {
+    bottom = usable.y + usable.height;
+  }
 
-    struct wlr_box box = {
-      .x = t->current.x - decorations_left,
-      .y = t->current.y - decorations_top,
-      .width = t->current.width + decorations_left + decorations_right + 1,
-      .height = t->current.height + decorations_top + decorations_bottom + 1,
-    };
+  return (struct wlr_box){
+    .x = left,
+    .y = top,
+    .width = right - left + 1,
+    .height = bottom - top + 1,
+  };
+}
 
-    if(wlr_box_contains_point(&box, x, y)) {
-      return t;
+struct mwc_toplevel *
+layout_toplevel_at(struct mwc_workspace *workspace, uint32_t x, uint32_t y) {
+  /* slots are kept in the grid of the output next to the surfaces */
+  struct spatial_entry **cell = spatial_grid_cell_at(workspace->output, x, y);
+  if(cell == NULL) return NULL;
+
+  size_t tile_count = array_len(workspace->tiles);
+  struct mwc_toplevel *found = NULL;
+  for(size_t i = 0; i < array_len(cell); i++) {
+    struct mwc_something *something = cell[i]->something;
+    if(something->type != MWC_TOPLEVEL) continue;
+
+    struct mwc_toplevel *t = something->toplevel;
+    if(t->workspace != workspace || t->layout_role == MWC_LAYOUT_NONE
+       || t->layout_index >= tile_count) continue;
+    if(!wlr_box_contains_point(&cell[i]->slot, x, y)) continue;
+
+    /* neighbouring slots share their edge, the first one in the layout wins */
+    if(found == NULL || t->layout_index < found->layout_index) {
+      found = t;
     }
   }
 
-  return NULL;
+  return found;
 }
-
@@ -5,13 +5,62 @@
 
 #include <stdint.h>
 
+struct wlr_box;
+
+/* arranges count tiled toplevels, in the order of masters then slaves, inside of area
+ * (already without outer gaps). boxes include the borders */
+typedef void (*layout_arrange_func_t)(struct wlr_box *area, uint32_t count,
+                                      uint32_t master_count, struct wlr_box *boxes);
+
+struct mwc_layout {
+  char *name;
+  layout_arrange_func_t arrange;
+  /* these are optional, if not set they are found from the tiles geometry */
+  struct mwc_toplevel *(*neighbor)(struct mwc_toplevel *toplevel, enum mwc_direction direction);
+  struct mwc_toplevel *(*closest)(struct mwc_workspace *workspace, bool master,
+                                  enum mwc_direction side);
+};
+
+#define LAYOUT_COUNT 5
+
+/* the first one is the default */
+extern const struct mwc_layout layouts[LAYOUT_COUNT];
+
+const struct mwc_layout *
+layout_from_name(char *name);
+
 void
-calculate_masters_dimensions(struct mwc_output *output, uint32_t master_count,
-                             uint32_t slave_count, uint32_t *width, uint32_t *height);
+layout_split_even(struct wlr_box *region, uint32_t count, bool horizontal, struct wlr_box *boxes);
 
 void
-calculate_slaves_dimensions(struct mwc_output *output, uint32_t slave_count,
-                            uint32_t *width, uint32_t *height);
+master_stack_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+                     struct wlr_box *boxes);
+
+void
+centered_master_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+                        struct wlr_box *boxes);
+
+void
+grid_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+             struct wlr_box *boxes);
+
+void
+monocle_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+                struct wlr_box *boxes);
+
+void
+bsp_arrange(struct wlr_box *area, uint32_t count, uint32_t master_count,
+            struct wlr_box *boxes);
+
+struct mwc_toplevel *
+master_stack_neighbor(struct mwc_toplevel *toplevel, enum mwc_direction direction);
+
+struct mwc_toplevel *
+monocle_neighbor(struct mwc_toplevel *toplevel, enum mwc_direction direction);
+
+struct mwc_toplevel *
+master_stack_closest(struct mwc_workspace *workspace, bool master,
+                     enum mwc_direction side);
 
 bool
 toplevel_is_master(struct mwc_toplevel *toplevel);
@@ -19,19 +68,58 @@ toplevel_is_master(struct mwc_toplevel *toplevel);
 bool
 toplevel_is_slave(struct mwc_toplevel *toplevel);
 
+/* inserts the toplevel after prev, which has to be in the list for the role.
+ * toplevel->workspace has to be set */
+void
+layout_insert(struct mwc_toplevel *toplevel, enum mwc_layout_role role, struct wl_list *prev);
+
+/* adds the toplevel as the last master if there is room, otherwise as the last slave */
+void
+layout_append(struct mwc_toplevel *toplevel);
+
+void
+layout_remove(struct mwc_toplevel *toplevel);
+
+/* moves the slave to the end of the masters */
+void
+layout_promote_slave(struct mwc_toplevel *slave);
+
+/* moves the last master to the end of the slaves */
+void
+layout_demote_last_master(struct mwc_workspace *workspace);
+
+struct mwc_toplevel *
+layout_first_tiled(struct mwc_workspace *workspace);
+
+struct mwc_toplevel *
+layout_next_tiled(struct mwc_toplevel *toplevel);
+
+struct mwc_toplevel *
+layout_prev_tiled(struct mwc_toplevel *toplevel);
+
 void
 layout_set_pending_state(struct mwc_workspace *workspace);
 
-/* this function assumes they are in the same workspace and
- * that t2 comes after t1 if in the same list */
+/* size a new tiled toplevel is going to get once it is mapped */
+void
+layout_predict_size(struct mwc_workspace *workspace, uint32_t *width, uint32_t *height);
+
+/* this function assumes they are in the same workspace */
 void
 layout_swap_tiled_toplevels(struct mwc_toplevel *t1,
                             struct mwc_toplevel *t2);
 
+/* the tiled toplevel in the direction, or NULL if it is at the edge */
+struct mwc_toplevel *
+layout_find_neighbor(struct mwc_toplevel *toplevel, enum mwc_direction direction);
+
 struct mwc_toplevel *
 layout_find_closest_tiled_toplevel(struct mwc_workspace *workspace, bool master,
                                    enum mwc_direction side);
 
+struct wlr_box
+layout_tile_slot(struct mwc_workspace *workspace, struct wlr_box *tile);
+
 struct mwc_toplevel *
 layout_toplevel_at(struct mwc_workspace *workspace, uint32_t x, uint32_t y);
 
@@ -1,4 +1,3 @@
-#include <pthread.h>
 #include <scenefx/render/fx_renderer/fx_renderer.h>
 #include <scenefx/types/wlr_scene.h>
 
@@ -142,9 +141,12 @@ main(int argc, char *argv[]) {
   sigaction(SIGCHLD, &sa, NULL);
 
   bool debug = false;
+  bool profile = false;
   for(int i = 1; i < argc; i++) {
     if(strcmp(argv[i], "--debug") == 0) {
       debug = true;
+    } else if(strcmp(argv[i], "--profile") == 0) {
+      profile = true;
     }
   }
 
@@ -166,11 +168,14 @@ main(int argc, char *argv[]) {
     wlr_log_init(WLR_INFO, NULL);
   }
 
-  server.config = config_load();
+  config_keywords_check();
+  config_resolve_paths();
+  server.config = config_load(server.config_path);
   if(server.config == NULL) {
     wlr_log(WLR_ERROR, "there was a problem loading the config, quiting");
     return 1;
   }
+  config_apply_env(server.config);
 
   /* The Wayland display is managed by libwayland. It handles accepting
    * clients from the Unix socket, manging Wayland globals, and so on. */
@@ -228,6 +233,11 @@ main(int argc, char *argv[]) {
   /* Configure a listener to be notified when new outputs are available on the
    * backend. */
   wl_list_init(&server.outputs);
+  wl_list_init(&server.metadata_dirty_toplevels);
+  server.metadata_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                                  toplevel_handle_metadata_timer, NULL);
+  wl_list_init(&server.spatial_entries);
+  wl_list_init(&server.spatial_dirty);
   server.new_output.notify = server_handle_new_output;
   wl_signal_add(&server.backend->events.new_output, &server.new_output);
 
@@ -419,15 +429,16 @@ main(int argc, char *argv[]) {
   /* Set the WAYLAND_DISPLAY environment variable to our socket */
   setenv("WAYLAND_DISPLAY", socket, true);
 
-  /* creating a thread for the ipc to run on */
-  pthread_t ipc_thread;
-  pthread_create(&ipc_thread, NULL, ipc_run, NULL);
-
-  pthread_t inotify_thread;
-  pthread_create(&inotify_thread, NULL, config_watch, server.config->dir);
+  /* the ipc is served from the event loop, so it never races with the compositor */
+  if(!ipc_init()) {
+    wlr_log(WLR_ERROR, "ipc: could not start, mwc-ipc will not work");
+  }
 
-  /* sleep a bit so the ipc starts, 0.1 seconds is probably enough */
-  usleep(100000);
+  /* saves to the config are noticed on the event loop, parsed on another thread
+   * and applied back on the event loop */
+  if(!config_watch_start()) {
+    wlr_log(WLR_ERROR, "config: could not watch for changes, it will not be reloaded on save");
+  }
 
   for(size_t i = 0; i < server.config->run_count; i++) {
     run_cmd(server.config->run[i]);
@@ -439,8 +450,20 @@ main(int argc, char *argv[]) {
   wlr_log(WLR_INFO, "running mwc on WAYLAND_DISPLAY=%s", socket);
   wl_display_run(server.wl_display);
 
+  ipc_finish();
   unlink(IPC_PATH);
 
+  if(profile) {
+    /* outputs are still alive here, they get destroyed with the backend */
+    FILE *stats = fopen("/tmp/mwc/frame-stats", "w");
+    if(stats != NULL) {
+      output_print_frame_stats(stats);
+      fclose(stats);
+    } else {
+      wlr_log(WLR_ERROR, "could not open /tmp/mwc/frame-stats for writing");
+    }
+  }
+
   /* Once wl_display_run returns, we destroy all clients then shut down the
    * server. */
   wl_display_destroy_clients(server.wl_display);
@@ -5,7 +5,9 @@
 #include "keyboard.h"
 #include "pointer.h"
 #include "session_lock.h"
+#include "ipc.h"
 
+#include <pthread.h>
 #include <wayland-server-protocol.h>
 #include <wlr/util/box.h>
 #include <wlr/types/wlr_server_decoration.h>
@@ -26,6 +28,13 @@ enum mwc_direction {
   MWC_LEFT,
 };
 
+/* which of the workspace lists a toplevel is in */
+enum mwc_layout_role {
+  MWC_LAYOUT_NONE,
+  MWC_LAYOUT_MASTER,
+  MWC_LAYOUT_SLAVE,
+};
+
 struct mwc_server {
 	struct wl_display *wl_display;
 	struct wl_event_loop *wl_event_loop;
@@ -81,6 +90,11 @@ struct mwc_server {
   struct mwc_keyboard *last_used_keyboard;
 
 	enum mwc_cursor_mode cursor_mode;
+  /* motion waiting to be handled in the next frame, see cursor_schedule_motion */
+  bool cursor_motion_pending;
+  uint32_t cursor_motion_time;
+  /* layout position of the surface with pointer focus as of the last hit test */
+  double pointer_focus_x, pointer_focus_y;
   /* this keeps state when the compositor is in the state of moving or
    * resizing toplevels */
 	struct mwc_toplevel *grabbed_toplevel;
@@ -105,6 +119,15 @@ struct mwc_server {
   bool exclusive;
   /* last focused toplevel before layer surface was given focus */
   struct mwc_toplevel *prev_focused;
+  /* toplevels whose title or app_id changed since the last frame */
+  struct wl_list metadata_dirty_toplevels;
+  /* flushes them if no frame does it first, e.g. with every output off */
+  struct wl_event_source *metadata_timer;
+  /* everything the output grids index, see spatial.h */
+  struct wl_list spatial_entries;
+  struct wl_list spatial_dirty;
+  /* hit testing walks the whole scene while there are any */
+  uint32_t popup_count;
 
 	struct wlr_output_layout *output_layout;
 	struct wl_list outputs;
@@ -137,9 +160,46 @@ struct mwc_server {
   struct wl_listener xdg_activation_new_token;
 
   struct mwc_config *config;
-
-  int *ipc_clients;
+  /* resolved once at startup, NULL if there is no user config path */
+  char *config_path;
+  char *default_config_path;
+  /* a config parsed by the parser thread, waiting to be applied on the event loop */
+  struct mwc_config *pending_config;
+  /* also guards config_parse_requested */
+  pthread_mutex_t pending_config_lock;
+  /* the parser thread writes to it to wake up the event loop */
+  int config_eventfd;
+  struct wl_event_source *config_source;
+  /* set by the debounce timer, the parser thread waits on the cond for it */
+  bool config_parse_requested;
+  pthread_cond_t config_parse_cond;
+  /* watches the config directory, events for other files are ignored */
+  int config_inotify_fd;
+  struct wl_event_source *config_inotify_source;
+  struct wl_event_source *config_debounce_timer;
+  char *config_file_name;
+
+  int ipc_fd;
+  struct wl_event_source *ipc_source;
+  struct wl_list ipc_clients;
   bool ipc_running;
+  /* replies are serialized here before being queued */
+  struct ipc_buffer ipc_reply;
+  /* bumped on every change to what a query lists, see ipc_query */
+  uint64_t ipc_generations[IPC_QUERY_COUNT];
+  struct ipc_snapshot ipc_snapshots[IPC_QUERY_COUNT];
+  /* mask of 1 << enum ipc_event waiting for the flush timer */
+  uint32_t ipc_pending_events;
+  struct wl_event_source *ipc_flush_timer;
+  bool ipc_flush_scheduled;
+  /* tree changes waiting for the flush timer, in the order they happened */
+  struct ipc_buffer ipc_tree_events;
+  /* some toplevel might have moved, toggled floating or fullscreen, or changed workspace */
+  bool ipc_tree_dirty;
+  /* toplevels are numbered from 1 in the order they are created */
+  uint32_t last_toplevel_id;
+  /* what was last sent for each event, so repeated identical events are dropped */
+  char ipc_last_events[IPC_EVENT_COUNT][512];
 
   bool running;
 };
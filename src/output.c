@@ -9,8 +9,11 @@
 #include "workspace.h"
 #include "toplevel.h"
 #include "ipc.h"
+#include "helpers.h"
+#include "array.h"
 
 #include <assert.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -49,6 +52,9 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
   output->frame.notify = output_handle_frame;
   wl_signal_add(&wlr_output->events.frame, &output->frame);
 
+  output->present.notify = output_handle_present;
+  wl_signal_add(&wlr_output->events.present, &output->present);
+
   output->request_state.notify = output_handle_request_state;
   wl_signal_add(&wlr_output->events.request_state, &output->request_state);
 
@@ -56,6 +62,7 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
   wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 
   wl_list_init(&output->workspaces);
+  wl_list_init(&output->active_toplevels);
 
   /* we check if this output already has some workspaces created */
   bool found = output_transfer_existing_workspaces(output);
@@ -79,8 +86,11 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
     wl_list_init(&workspace->floating_toplevels);
     wl_list_init(&workspace->masters);
     wl_list_init(&workspace->slaves);
+    wl_list_init(&workspace->transaction.toplevels);
+    array_init(&workspace->tiles);
     workspace->output = output;
     workspace->index = 0;
+    workspace->layout = &layouts[0];
 
     wl_list_insert(&output->workspaces, &workspace->link);
 
@@ -93,6 +103,9 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
   wl_list_init(&output->layers.overlay);
 
   wl_list_insert(&server.outputs, &output->link);
+  ipc_invalidate(IPC_QUERY_OUTPUTS);
+  ipc_invalidate(IPC_QUERY_TOPLEVELS);
+  ipc_output_add(output);
 
   output->scene_output = wlr_scene_output_create(server.scene, output->wlr_output);
   struct wlr_box output_box = output_add_to_layout(output, output_config);
@@ -103,7 +116,9 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
     wl_list_for_each(w, &output->workspaces, link) {
       layout_set_pending_state(w);
       /* this pathces some ghosts that might have been left in the scene */
-      if(w != output->active_workspace) {
+      if(w == output->active_workspace) {
+        workspace_schedule_dirty_toplevels(w);
+      } else {
         struct mwc_toplevel *t;
         wl_list_for_each(t, &w->floating_toplevels, link) {
           wlr_scene_node_set_enabled(&t->scene_tree->node, false);
@@ -165,6 +180,7 @@ output_transfer_existing_workspaces(struct mwc_output *output) {
         w->output = output;
         wl_list_remove(&w->link);
         wl_list_insert(&output->workspaces, &w->link);
+        ipc_invalidate(IPC_QUERY_TOPLEVELS);
         if(output->active_workspace == NULL) {
           output->active_workspace = w;
         }
@@ -280,6 +296,24 @@ output_frame_duration_ms(struct mwc_output *output) {
   return 1000000.0 / output->wlr_output->refresh;
 }
 
+double
+output_predict_presentation_ms(struct mwc_output *output, struct timespec *now) {
+  /* the frame being rendered now is shown on the first vblank after now; we
+   * find it from the last presentation feedback and the refresh rate */
+  double now_ms = timespec_to_ms(now);
+
+  struct timespec *last = &output->frame_stats.last_present;
+  if(output->wlr_output->refresh <= 0 || (last->tv_sec == 0 && last->tv_nsec == 0)) {
+    return now_ms;
+  }
+
+  double last_ms = timespec_to_ms(last);
+  double period = output_frame_duration_ms(output);
+  double vblanks = ceil((now_ms - last_ms) / period);
+
+  return last_ms + max(vblanks, 1.0) * period;
+}
+
 struct mwc_output *
 output_get_relative(struct mwc_output *output, enum mwc_direction direction) {
   struct wlr_box original_output_box;
@@ -335,6 +369,8 @@ cursor_jump_output(struct mwc_output *output) {
   wlr_cursor_warp(server.cursor, NULL,
                   output_box.x + output_box.width / 2.0,
                   output_box.y + output_box.height / 2.0);
+  /* the warp replaces whatever motion was waiting for the next frame */
+  server.cursor_motion_pending = false;
 
   struct timespec now;
   clock_gettime(CLOCK_MONOTONIC, &now);
@@ -399,19 +435,58 @@ output_handle_frame(struct wl_listener *listener, void *data) {
   struct mwc_output *output = wl_container_of(listener, output, frame);
   struct mwc_workspace *workspace = output->active_workspace;
 
-  workspace_draw_frame(workspace);
+  struct timespec start, drawn, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  /* whichever output draws first handles title and app_id changes of all the toplevels */
+  toplevels_flush_metadata();
+  /* and the pointer motion since the last frame, so a moved toplevel is drawn right away */
+  cursor_flush_motion();
+
+  workspace_draw_frame(workspace, output_predict_presentation_ms(output, &start));
+
+  clock_gettime(CLOCK_MONOTONIC, &drawn);
 
   struct wlr_scene_output *scene_output = wlr_scene_get_scene_output(server.scene,
                                                                      output->wlr_output);
 
   wlr_scene_output_commit(scene_output, NULL);
 
-  struct timespec now;
   clock_gettime(CLOCK_MONOTONIC, &now);
 
+  struct frame_histogram *histograms = output->frame_stats.histograms;
+  frame_histogram_add(&histograms[FRAME_STAT_DRAW], timespec_diff_us(&drawn, &start));
+  frame_histogram_add(&histograms[FRAME_STAT_COMMIT], timespec_diff_us(&now, &drawn));
+
   wlr_scene_output_send_frame_done(scene_output, &now);
 }
 
+void
+output_handle_present(struct wl_listener *listener, void *data) {
+  struct mwc_output *output = wl_container_of(listener, output, present);
+  struct wlr_output_event_present *event = data;
+
+  if(!event->presented || event->when == NULL) return;
+
+  frame_stats_add_present(&output->frame_stats, event->when);
+}
+
+void
+output_print_frame_stats(FILE *stream) {
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    frame_stats_print(&output->frame_stats, output->wlr_output->name, stream);
+  }
+}
+
+void
+output_reset_frame_stats(void) {
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    output->frame_stats = (struct frame_stats){0};
+  }
+}
+
 void
 output_handle_request_state(struct wl_listener *listener, void *data) {
   /* this function is called when the backend requests a new state for
@@ -449,19 +524,33 @@ output_handle_destroy(struct wl_listener *listener, void *data) {
         w->output = new;
         wl_list_remove(&w->link);
         wl_list_insert(&new->workspaces, &w->link);
+        ipc_invalidate(IPC_QUERY_TOPLEVELS);
+        ipc_workspace_output(w);
         layout_set_pending_state(w);
       }
     }
   }
 
+  /* whatever is still waiting for a frame here gets scheduled once it is visible again */
+  struct mwc_toplevel *t, *tmp;
+  wl_list_for_each_safe(t, tmp, &output->active_toplevels, active_link) {
+    wl_list_remove(&t->active_link);
+    wl_list_init(&t->active_link);
+  }
+
   if(output->session_lock_rect != NULL) {
     wlr_scene_node_destroy(&output->session_lock_rect->node);
   }
 
   wl_list_remove(&output->frame.link);
+  wl_list_remove(&output->present.link);
   wl_list_remove(&output->request_state.link);
   wl_list_remove(&output->destroy.link);
   wl_list_remove(&output->link);
+  spatial_grid_finish(&output->spatial);
+  ipc_invalidate(IPC_QUERY_OUTPUTS);
+  ipc_invalidate(IPC_QUERY_LAYERS);
+  ipc_output_remove(output);
 
   free(output);
 }
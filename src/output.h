@@ -6,6 +6,10 @@
 
 #include "workspace.h"
 #include "mwc.h"
+#include "frame_stats.h"
+#include "spatial.h"
+
+#include <stdio.h>
 
 struct mwc_output {
 	struct wl_list link;
@@ -24,10 +28,21 @@ struct mwc_output {
   struct wlr_scene_optimized_blur *blur;
 
   struct mwc_workspace *active_workspace;
+  /* toplevels that are animating or changed since the last frame */
+  struct wl_list active_toplevels;
+  /* while set toplevels only note that they need a frame, see layout_set_pending_state() */
+  bool defer_frames;
+  bool frame_deferred;
 
   struct wlr_scene_rect *session_lock_rect;
 
+  struct frame_stats frame_stats;
+
+  /* toplevels and layer surfaces by where they are, for hit testing */
+  struct spatial_grid spatial;
+
 	struct wl_listener frame;
+	struct wl_listener present;
 	struct wl_listener request_state;
 	struct wl_listener destroy;
 };
@@ -53,6 +68,9 @@ output_apply_preffered_mode(struct wlr_output *wlr_output, struct wlr_output_sta
 double
 output_frame_duration_ms(struct mwc_output *output);
 
+double
+output_predict_presentation_ms(struct mwc_output *output, struct timespec *now);
+
 struct mwc_output *
 output_get_relative(struct mwc_output *output, enum mwc_direction direction);
 
@@ -66,6 +84,15 @@ focus_output(struct mwc_output *output,
 void
 output_handle_frame(struct wl_listener *listener, void *data);
 
+void
+output_handle_present(struct wl_listener *listener, void *data);
+
+void
+output_print_frame_stats(FILE *stream);
+
+void
+output_reset_frame_stats(void);
+
 void
 output_handle_request_state(struct wl_listener *listener, void *data);
 
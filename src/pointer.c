@@ -130,6 +130,8 @@ server_reset_cursor_mode() {
   /* reset the cursor mode to passthrough. */
   server.cursor_mode = MWC_CURSOR_PASSTHROUGH;
   server.grabbed_toplevel->resizing = false;
+  /* the grab may have ended on another workspace */
+  ipc_toplevel_changed();
   server.grabbed_toplevel = NULL;
   server.client_driven_move_resize = false;
 
@@ -160,6 +162,7 @@ cursor_handle_motion(uint32_t time) {
         } else {
           server.grabbed_toplevel->workspace = prev_workspace;
           wl_list_insert(&prev_workspace->floating_toplevels, &server.grabbed_toplevel->link);
+          ipc_invalidate(IPC_QUERY_TOPLEVELS);
         }
 
         server_reset_cursor_mode();
@@ -224,10 +227,49 @@ pointer_handle_focus(uint32_t time, bool handle_keyboard_focus) {
     constraint_set_as_current(wlr_constraint->data);
   }
 
+  server.pointer_focus_x = server.cursor->x - sx;
+  server.pointer_focus_y = server.cursor->y - sy;
+
   wlr_seat_pointer_notify_enter(seat, surface, sx, sy);
   wlr_seat_pointer_notify_motion(seat, time, sx, sy);
 }
 
+/* mice with a high polling rate send thousands of events a second. clients
+ * still get every one of them right away, relative to the surface found by
+ * the last hit test, but focus, the hit test and move/resize only run once
+ * per frame or when a button or axis event needs them */
+void
+cursor_schedule_motion(uint32_t time) {
+  server.cursor_motion_time = time;
+
+  struct wlr_seat *seat = server.seat;
+  if(server.cursor_mode == MWC_CURSOR_PASSTHROUGH
+     && seat->pointer_state.focused_surface != NULL) {
+    wlr_seat_pointer_notify_motion(seat, time,
+                                   server.cursor->x - server.pointer_focus_x,
+                                   server.cursor->y - server.pointer_focus_y);
+  }
+
+  if(server.cursor_motion_pending) return;
+  server.cursor_motion_pending = true;
+
+  /* a hardware cursor moves without a frame, so we ask for one */
+  struct wlr_output *wlr_output = wlr_output_layout_output_at(server.output_layout,
+                                                              server.cursor->x, server.cursor->y);
+  if(wlr_output != NULL) {
+    wlr_output_schedule_frame(wlr_output);
+  }
+}
+
+void
+cursor_flush_motion(void) {
+  if(!server.cursor_motion_pending) return;
+  server.cursor_motion_pending = false;
+
+  cursor_handle_motion(server.cursor_motion_time);
+  wlr_seat_pointer_notify_frame(server.seat);
+}
+
 void
 server_handle_cursor_motion(struct wl_listener *listener, void *data) {
   struct wlr_pointer_motion_event *event = data;
@@ -241,7 +283,7 @@ server_handle_cursor_motion(struct wl_listener *listener, void *data) {
                                                        event->unaccel_dx, event->unaccel_dy);
 
   wlr_cursor_move(server.cursor, &event->pointer->base, event->delta_x, event->delta_y);
-  cursor_handle_motion(event->time_msec);
+  cursor_schedule_motion(event->time_msec);
 }
 
 void
@@ -261,35 +303,25 @@ server_handle_cursor_motion_absolute(struct wl_listener *listener, void *data) {
                                                        dx, dy, dx, dy);
 
   wlr_cursor_warp_absolute(server.cursor, &event->pointer->base, event->x, event->y);
-  cursor_handle_motion(event->time_msec);
+  cursor_schedule_motion(event->time_msec);
 }
 
 void
 server_handle_cursor_button(struct wl_listener *listener, void *data) {
   struct wlr_pointer_button_event *event = data;
 
+  /* the button goes to whatever is under the cursor now */
+  cursor_flush_motion();
+
   uint32_t modifiers = server.last_used_keyboard
     ? wlr_keyboard_get_modifiers(server.last_used_keyboard->wlr_keyboard)
     : 0;
 
-  struct keybind *k;
-  wl_list_for_each(k, &server.config->pointer_keybinds, link) {
-    if(!k->initialized) continue;
-
-    if(k->active && k->stop && event->button == k->key
-       && event->state == WL_POINTER_BUTTON_STATE_RELEASED) {
-      k->active = false;
-      k->stop(k->args);
-      return;
-    }
-
-    if(modifiers == k->modifiers && event->button == k->key
-       && event->state == WL_POINTER_BUTTON_STATE_PRESSED) {
-      k->active = true;
-      k->action(k->args);
-      return;
-    }
-  }
+  struct keybind_table *table = &server.config->pointer_keybind_table;
+  bool handled = event->state == WL_POINTER_BUTTON_STATE_PRESSED
+    ? keybind_table_press(table, modifiers, event->button)
+    : keybind_table_release(table, event->button);
+  if(handled) return;
 
   /* notify the client with pointer focus that a button press has occurred */
   wlr_seat_pointer_notify_button(server.seat, event->time_msec,
@@ -312,6 +344,7 @@ server_handle_cursor_button(struct wl_listener *listener, void *data) {
       toplevel_tiled_insert_into_layout(server.grabbed_toplevel, server.cursor->x, server.cursor->y);
     } else {
       wl_list_insert(server.active_workspace->floating_toplevels.next, &server.grabbed_toplevel->link);
+      ipc_invalidate(IPC_QUERY_TOPLEVELS);
     }
 
     server_reset_cursor_mode();
@@ -324,6 +357,8 @@ void
 server_handle_cursor_axis(struct wl_listener *listener, void *data) {
   struct wlr_pointer_axis_event *event = data;
 
+  cursor_flush_motion();
+
   /* notify the client with pointer focus of the axis event */
   wlr_seat_pointer_notify_axis(server.seat,
                                event->time_msec, event->orientation, event->delta,
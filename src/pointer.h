@@ -44,6 +44,12 @@ cursor_handle_motion(uint32_t time);
 void
 pointer_handle_focus(uint32_t time, bool handle_keyboard_focus);
 
+void
+cursor_schedule_motion(uint32_t time);
+
+void
+cursor_flush_motion(void);
+
 void
 server_handle_cursor_motion(struct wl_listener *listener, void *data);
 
@@ -44,6 +44,7 @@ server_handle_new_popup(struct wl_listener *listener, void *data) {
 
   popup->destroy.notify = xdg_popup_handle_destroy;
   wl_signal_add(&xdg_popup->events.destroy, &popup->destroy);
+  server.popup_count++;
 }
 
 void
@@ -77,6 +78,14 @@ xdg_popup_handle_commit(struct wl_listener *listener, void *data) {
       wlr_xdg_popup_unconstrain_from_box(popup->xdg_popup, &output_box);
     }
   }
+
+  /* the popup might have new buffers which need the effects of its toplevel */
+  if(popup->scene_tree != NULL) {
+    struct mwc_something *root = popup_get_root_parent(popup);
+    if(root->type == MWC_TOPLEVEL) {
+      toplevel_mark_effects_dirty(root->toplevel, MWC_DIRTY_OPACITY);
+    }
+  }
 }
 
 void
@@ -85,6 +94,7 @@ xdg_popup_handle_destroy(struct wl_listener *listener, void *data) {
 
   wl_list_remove(&popup->commit.link);
   wl_list_remove(&popup->destroy.link);
+  server.popup_count--;
 
   free(popup);
 }
@@ -201,26 +201,27 @@ toplevel_apply_clip(struct mwc_toplevel *toplevel) {
 
 double
 find_animation_curve_at(double t) {
-  size_t down = 0;
-  size_t up = BAKED_POINTS_COUNT - 1;
-
-  size_t middle = (up + down) / 2;
-  while(up - down != 1) {
-    if(server.config->baked_points[middle].x <= t) {
-      down = middle;  
-    } else {
-      up = middle;
-    }
-    middle = (up + down) / 2;
-  }
+  return bezier_curve_sample(&server.config->animation_curve, t);
+}
 
-  return server.config->baked_points[up].y;
+double
+calculate_animation_passed(struct mwc_animation *animation, double time) {
+  if(animation->duration <= 0) return 1.0;
+
+  double passed = (time - animation->start) / animation->duration;
+  return passed < 0.0 ? 0.0 : passed > 1.0 ? 1.0 : passed;
 }
 
 bool
-toplevel_animation_next_tick(struct mwc_toplevel *toplevel) {
-  double animation_passed =
-    (double)toplevel->animation.passed_frames / toplevel->animation.total_frames;
+toplevel_animation_next_tick(struct mwc_toplevel *toplevel, double time) {
+  /* the animation starts with the first frame it is shown in */
+  if(toplevel->animation.start == 0) {
+    toplevel->animation.start = time;
+  }
+
+  /* progress depends only on the time the frame is presented at, so dropped
+   * frames are skipped over instead of slowing the animation down */
+  double animation_passed = calculate_animation_passed(&toplevel->animation, time);
   double factor = find_animation_curve_at(animation_passed);
 
   uint32_t width = toplevel->animation.initial.width +
@@ -245,10 +246,9 @@ toplevel_animation_next_tick(struct mwc_toplevel *toplevel) {
   if(animation_passed >= 1.0) {
     toplevel->animation.running = false;
     return false;
-  } else {
-    toplevel->animation.passed_frames++;
-    return true;
   }
+
+  return true;
 }
 
 void
@@ -307,10 +307,48 @@ toplevel_draw_shadow(struct mwc_toplevel *toplevel) {
 }
 
 bool
-toplevel_draw_frame(struct mwc_toplevel *toplevel) {
+toplevel_is_visible(struct mwc_toplevel *toplevel) {
+  if(!toplevel->xdg_toplevel->base->surface->mapped) return false;
+  if(toplevel == server.grabbed_toplevel) return true;
+
+  struct mwc_workspace *workspace = toplevel->workspace;
+  return workspace == workspace->output->active_workspace
+    && (workspace->fullscreen_toplevel == NULL || workspace->fullscreen_toplevel == toplevel);
+}
+
+void
+toplevel_schedule_frame(struct mwc_toplevel *toplevel) {
+  /* hidden toplevels keep their dirty state and get scheduled once they are shown */
+  if(!toplevel_is_visible(toplevel)) return;
+
+  /* it might still be in the set of some other output it was on before */
+  struct mwc_output *output = toplevel->workspace->output;
+  wl_list_remove(&toplevel->active_link);
+  wl_list_insert(&output->active_toplevels, &toplevel->active_link);
+
+  if(output->defer_frames) {
+    output->frame_deferred = true;
+  } else {
+    wlr_output_schedule_frame(output->wlr_output);
+  }
+}
+
+void
+toplevel_mark_effects_dirty(struct mwc_toplevel *toplevel, uint32_t mask) {
+  toplevel->effects_dirty |= mask;
+  toplevel_schedule_frame(toplevel);
+}
+
+bool
+toplevel_draw_frame(struct mwc_toplevel *toplevel, double time) {
   bool need_more_frames = false;
+  /* the position, borders, shadow and clip below all change its box */
+  spatial_entry_mark_dirty(&toplevel->spatial);
+
   if(toplevel->animation.running) {
-    if(toplevel_animation_next_tick(toplevel)) {
+    /* every tick changes the size, so everything depending on it is redone */
+    toplevel->effects_dirty |= MWC_DIRTY_GEOMETRY;
+    if(toplevel_animation_next_tick(toplevel, time)) {
       need_more_frames = true;
     }
   } else {
@@ -318,51 +356,79 @@ toplevel_draw_frame(struct mwc_toplevel *toplevel) {
                                 toplevel->current.x, toplevel->current.y);
   }
 
-  if(server.config->border_width > 0) {
+  uint32_t dirty = toplevel->effects_dirty;
+  if(dirty == 0) return need_more_frames;
+
+  if(server.config->border_width > 0
+     && dirty & (MWC_DIRTY_GEOMETRY | MWC_DIRTY_FOCUS
+                 | MWC_DIRTY_RADIUS | MWC_DIRTY_FULLSCREEN)) {
     toplevel_draw_borders(toplevel);
   }
-  if(server.config->shadows) {
+  if(server.config->shadows
+     && dirty & (MWC_DIRTY_GEOMETRY | MWC_DIRTY_RADIUS | MWC_DIRTY_FULLSCREEN)) {
     toplevel_draw_shadow(toplevel);
   }
-  toplevel_apply_clip(toplevel);
+  if(dirty & (MWC_DIRTY_GEOMETRY | MWC_DIRTY_FULLSCREEN)) {
+    toplevel_apply_clip(toplevel);
+  }
+  /* opacity, corners and blur of the buffers depend on all of it */
   toplevel_apply_effects(toplevel);
 
+  toplevel->effects_dirty = 0;
+
   return need_more_frames;
 }
 
 void
-workspace_draw_frame(struct mwc_workspace *workspace) {
-  if(server.grabbed_toplevel != NULL) {
-    toplevel_draw_frame(server.grabbed_toplevel);
-  }
-
-  bool need_more_frames = false;
+workspace_schedule_dirty_toplevels(struct mwc_workspace *workspace) {
+  /* called when toplevels of this workspace might have become visible */
   struct mwc_toplevel *t;
-  if(workspace->fullscreen_toplevel != NULL) {
-    if(toplevel_draw_frame(workspace->fullscreen_toplevel)) {
-      need_more_frames = true;
+  wl_list_for_each(t, &workspace->floating_toplevels, link) {
+    if(t->effects_dirty != 0 || t->animation.running) {
+      toplevel_schedule_frame(t);
     }
-  } else {
-    wl_list_for_each(t, &workspace->floating_toplevels, link) {
-      if(toplevel_draw_frame(t)) {
-        need_more_frames = true;
-      }
+  }
+  wl_list_for_each(t, &workspace->masters, link) {
+    if(t->effects_dirty != 0 || t->animation.running) {
+      toplevel_schedule_frame(t);
+    }
+  }
+  wl_list_for_each(t, &workspace->slaves, link) {
+    if(t->effects_dirty != 0 || t->animation.running) {
+      toplevel_schedule_frame(t);
+    }
+  }
+}
+
+void
+workspace_draw_frame(struct mwc_workspace *workspace, double time) {
+  struct mwc_output *output = workspace->output;
+
+  /* we only touch toplevels that changed or are animating, everything else
+   * on the screen is already in the state it should be */
+  struct mwc_toplevel *t, *tmp;
+  wl_list_for_each_safe(t, tmp, &output->active_toplevels, active_link) {
+    if(!toplevel_is_visible(t)) {
+      wl_list_remove(&t->active_link);
+      wl_list_init(&t->active_link);
+      continue;
     }
-    wl_list_for_each(t, &workspace->masters, link) {
-      if(toplevel_draw_frame(t)) {
-        need_more_frames = true;
-      }
+
+    /* its workspace was moved to another output */
+    if(t->workspace->output != output) {
+      toplevel_schedule_frame(t);
+      continue;
     }
-    wl_list_for_each(t, &workspace->slaves, link) {
-      if(toplevel_draw_frame(t)) {
-        need_more_frames = true;
-      }
+
+    if(!toplevel_draw_frame(t, time)) {
+      wl_list_remove(&t->active_link);
+      wl_list_init(&t->active_link);
     }
   }
 
   /* if there are animation that are not finished we request more frames
    * for the output, until all the animations are done */
-  if(need_more_frames) {
-    wlr_output_schedule_frame(workspace->output->wlr_output);
+  if(!wl_list_empty(&output->active_toplevels)) {
+    wlr_output_schedule_frame(output->wlr_output);
   }
 }
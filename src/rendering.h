@@ -10,11 +10,24 @@ enum mwc_border_state {
   MWC_BORDER_INACTIVE,
 };
 
+/* what changed on a toplevel since it was last drawn; toplevel_draw_frame only
+ * redoes the work that depends on the set bits */
+enum mwc_effects_dirty {
+  MWC_DIRTY_GEOMETRY = 1 << 0,
+  MWC_DIRTY_FOCUS = 1 << 1,
+  MWC_DIRTY_OPACITY = 1 << 2,
+  MWC_DIRTY_RADIUS = 1 << 3,
+  MWC_DIRTY_BLUR = 1 << 4,
+  MWC_DIRTY_FULLSCREEN = 1 << 5,
+  MWC_DIRTY_ALL = (1 << 6) - 1,
+};
+
 struct mwc_animation {
   bool should_animate;
   bool running;
-  uint32_t total_frames;
-  uint32_t passed_frames;
+  /* in ms on the monotonic clock; 0 until the first frame the animation is drawn in */
+  double start;
+  double duration;
   struct wlr_box initial;
   struct wlr_box current;
 };
@@ -35,13 +48,22 @@ void
 toplevel_draw_placeholder(struct mwc_toplevel *toplevel);
 
 double
-calculate_animation_passed(struct mwc_animation *animation);
+calculate_animation_passed(struct mwc_animation *animation, double time);
 
 bool
-toplevel_animation_next_tick(struct mwc_toplevel *toplevel);
+toplevel_animation_next_tick(struct mwc_toplevel *toplevel, double time);
+
+bool
+toplevel_is_visible(struct mwc_toplevel *toplevel);
+
+void
+toplevel_schedule_frame(struct mwc_toplevel *toplevel);
+
+void
+toplevel_mark_effects_dirty(struct mwc_toplevel *toplevel, uint32_t mask);
 
 bool
-toplevel_draw_frame(struct mwc_toplevel *toplevel);
+toplevel_draw_frame(struct mwc_toplevel *toplevel, double time);
 
 void
 toplevel_apply_clip(struct mwc_toplevel *toplevel);
@@ -52,7 +74,10 @@ toplevel_unclip_size(struct mwc_toplevel *toplevel);
 struct mwc_workspace;
 
 void
-workspace_draw_frame(struct mwc_workspace *workspace);
+workspace_schedule_dirty_toplevels(struct mwc_workspace *workspace);
+
+void
+workspace_draw_frame(struct mwc_workspace *workspace, double time);
 
 void
 toplevel_apply_effects(struct mwc_toplevel *toplevel);
@@ -5,6 +5,9 @@
 #include "mwc.h"
 #include "layer_surface.h"
 #include "session_lock.h"
+#include "spatial.h"
+#include "toplevel.h"
+#include "transaction.h"
 
 #include <wlr/types/wlr_xdg_shell.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
@@ -52,8 +55,7 @@ struct mwc_something *
 something_at(double lx, double ly, struct wlr_surface **surface,
              double *sx, double *sy) {
   /* this returns the topmost node in the scene at the given layout coords */
-  struct wlr_scene_node *node = wlr_scene_node_at(&server.scene->tree.node,
-                                                  lx, ly, sx, sy);
+  struct wlr_scene_node *node = spatial_node_at(lx, ly, sx, sy);
   if(node == NULL || node->type != WLR_SCENE_NODE_BUFFER) {
     return NULL;
   }
@@ -62,7 +64,9 @@ something_at(double lx, double ly, struct wlr_surface **surface,
   struct wlr_scene_surface *scene_surface =
     wlr_scene_surface_try_from_buffer(scene_buffer);
   if(scene_surface == NULL) {
-    return NULL;
+    /* a toplevel waiting on a transaction shows copies of its buffers */
+    struct mwc_toplevel *toplevel = transaction_saved_buffer_at(node, lx, ly, surface, sx, sy);
+    return toplevel != NULL ? &toplevel->something : NULL;
   }
 
   *surface = scene_surface->surface;
@@ -0,0 +1,360 @@
+#include <scenefx/types/wlr_scene.h>
+
+#include "spatial.h"
+
+#include "array.h"
+#include "mwc.h"
+#include "output.h"
+#include "something.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/box.h>
+
+extern struct mwc_server server;
+
+void
+spatial_entry_init(struct spatial_entry *entry, struct mwc_something *something,
+                   struct wlr_scene_node *node) {
+  *entry = (struct spatial_entry){
+    .something = something,
+    .node = node,
+  };
+
+  wl_list_insert(&server.spatial_entries, &entry->link);
+  wl_list_init(&entry->dirty_link);
+  spatial_entry_mark_dirty(entry);
+}
+
+void
+spatial_entry_finish(struct spatial_entry *entry) {
+  struct mwc_output *output;
+  wl_list_for_each(output, &server.outputs, link) {
+    spatial_grid_remove(&output->spatial, entry);
+  }
+
+  wl_list_remove(&entry->dirty_link);
+  wl_list_remove(&entry->link);
+}
+
+void
+spatial_entry_set_node(struct spatial_entry *entry, struct wlr_scene_node *node) {
+  entry->node = node;
+  spatial_entry_mark_dirty(entry);
+}
+
+void
+spatial_entry_set_slot(struct spatial_entry *entry, struct wlr_box slot) {
+  entry->slot = slot;
+  spatial_entry_mark_dirty(entry);
+}
+
+void
+spatial_entry_mark_dirty(struct spatial_entry *entry) {
+  if(entry->dirty) return;
+
+  entry->dirty = true;
+  wl_list_insert(server.spatial_dirty.prev, &entry->dirty_link);
+}
+
+/* grows extents by node and everything enabled below it, node being at x, y */
+void
+spatial_node_extents(struct wlr_scene_node *node, int32_t x, int32_t y,
+                     struct wlr_box *extents) {
+  int32_t width, height;
+  switch(node->type) {
+    case WLR_SCENE_NODE_TREE: {
+      struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+      struct wlr_scene_node *child;
+      wl_list_for_each(child, &tree->children, link) {
+        if(!child->enabled) continue;
+
+        /* while there are popups the scene is walked anyway, see spatial_node_at() */
+        struct mwc_something *something = child->data;
+        if(child->type == WLR_SCENE_NODE_TREE && something != NULL
+           && something->type == MWC_POPUP) continue;
+
+        spatial_node_extents(child, x + child->x, y + child->y, extents);
+      }
+      return;
+    }
+    case WLR_SCENE_NODE_RECT: {
+      struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
+      width = rect->width;
+      height = rect->height;
+      break;
+    }
+    case WLR_SCENE_NODE_SHADOW: {
+      struct wlr_scene_shadow *shadow = wlr_scene_shadow_from_node(node);
+      width = shadow->width;
+      height = shadow->height;
+      break;
+    }
+    case WLR_SCENE_NODE_BUFFER: {
+      struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+      if(buffer->dst_width > 0 && buffer->dst_height > 0) {
+        width = buffer->dst_width;
+        height = buffer->dst_height;
+      } else if(buffer->buffer != NULL) {
+        /* the transform might swap them, so we take the bigger one both ways */
+        width = height = max(buffer->buffer->width, buffer->buffer->height);
+      } else {
+        return;
+      }
+      break;
+    }
+    default:
+      return;
+  }
+
+  if(width <= 0 || height <= 0) return;
+
+  if(wlr_box_empty(extents)) {
+    *extents = (struct wlr_box){ .x = x, .y = y, .width = width, .height = height };
+    return;
+  }
+
+  int32_t x1 = min(extents->x, x);
+  int32_t y1 = min(extents->y, y);
+  int32_t x2 = max(extents->x + extents->width, x + width);
+  int32_t y2 = max(extents->y + extents->height, y + height);
+  *extents = (struct wlr_box){ .x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1 };
+}
+
+/* recomputes the boxes of everything that changed since the last query */
+void
+spatial_flush(void) {
+  struct spatial_entry *entry, *tmp;
+  wl_list_for_each_safe(entry, tmp, &server.spatial_dirty, dirty_link) {
+    wl_list_remove(&entry->dirty_link);
+    wl_list_init(&entry->dirty_link);
+    entry->dirty = false;
+
+    entry->box = (struct wlr_box){0};
+    if(entry->node != NULL) {
+      /* the root itself might be disabled on a hidden workspace, that is checked
+       * when hit testing, so it does not need a new box when it is shown again */
+      int32_t x, y;
+      wlr_scene_node_coords(entry->node, &x, &y);
+      spatial_node_extents(entry->node, x, y, &entry->box);
+    }
+
+    struct wlr_box indexed = entry->box;
+    if(!wlr_box_empty(&entry->slot)) {
+      struct wlr_box extents = entry->slot;
+      if(!wlr_box_empty(&indexed)) {
+        int32_t x1 = min(extents.x, indexed.x);
+        int32_t y1 = min(extents.y, indexed.y);
+        int32_t x2 = max(extents.x + extents.width, indexed.x + indexed.width);
+        int32_t y2 = max(extents.y + extents.height, indexed.y + indexed.height);
+        extents = (struct wlr_box){ .x = x1, .y = y1, .width = x2 - x1, .height = y2 - y1 };
+      }
+      indexed = extents;
+    }
+
+    if(wlr_box_equal(&indexed, &entry->indexed)) continue;
+
+    struct mwc_output *output;
+    wl_list_for_each(output, &server.outputs, link) {
+      spatial_grid_remove(&output->spatial, entry);
+    }
+    entry->indexed = indexed;
+    wl_list_for_each(output, &server.outputs, link) {
+      spatial_grid_insert(&output->spatial, entry);
+    }
+  }
+}
+
+void
+spatial_grid_finish(struct spatial_grid *grid) {
+  if(grid->cells == NULL) return;
+
+  for(int32_t i = 0; i < grid->columns * grid->rows; i++) {
+    array_destroy(&grid->cells[i]);
+  }
+  free(grid->cells);
+  *grid = (struct spatial_grid){0};
+}
+
+void
+spatial_grid_rebuild(struct spatial_grid *grid, struct wlr_box *box) {
+  spatial_grid_finish(grid);
+
+  grid->box = *box;
+  grid->columns = (box->width + SPATIAL_CELL_SIZE - 1) / SPATIAL_CELL_SIZE;
+  grid->rows = (box->height + SPATIAL_CELL_SIZE - 1) / SPATIAL_CELL_SIZE;
+  grid->cells = calloc(grid->columns * grid->rows, sizeof(*grid->cells));
+  for(int32_t i = 0; i < grid->columns * grid->rows; i++) {
+    array_init(&grid->cells[i]);
+  }
+
+  struct spatial_entry *entry;
+  wl_list_for_each(entry, &server.spatial_entries, link) {
+    spatial_grid_insert(grid, entry);
+  }
+}
+
+/* cells of the grid that the indexed box of the entry touches */
+bool
+spatial_grid_range(struct spatial_grid *grid, struct spatial_entry *entry,
+                   int32_t *x1, int32_t *y1, int32_t *x2, int32_t *y2) {
+  if(grid->cells == NULL) return false;
+
+  struct wlr_box clipped;
+  if(!wlr_box_intersection(&clipped, &grid->box, &entry->indexed)) return false;
+
+  *x1 = (clipped.x - grid->box.x) / SPATIAL_CELL_SIZE;
+  *y1 = (clipped.y - grid->box.y) / SPATIAL_CELL_SIZE;
+  *x2 = (clipped.x + clipped.width - 1 - grid->box.x) / SPATIAL_CELL_SIZE;
+  *y2 = (clipped.y + clipped.height - 1 - grid->box.y) / SPATIAL_CELL_SIZE;
+  return true;
+}
+
+void
+spatial_grid_insert(struct spatial_grid *grid, struct spatial_entry *entry) {
+  int32_t x1, y1, x2, y2;
+  if(!spatial_grid_range(grid, entry, &x1, &y1, &x2, &y2)) return;
+
+  for(int32_t row = y1; row <= y2; row++) {
+    for(int32_t column = x1; column <= x2; column++) {
+      array_push(&grid->cells[row * grid->columns + column], entry);
+    }
+  }
+}
+
+void
+spatial_grid_remove(struct spatial_grid *grid, struct spatial_entry *entry) {
+  int32_t x1, y1, x2, y2;
+  if(!spatial_grid_range(grid, entry, &x1, &y1, &x2, &y2)) return;
+
+  for(int32_t row = y1; row <= y2; row++) {
+    for(int32_t column = x1; column <= x2; column++) {
+      struct spatial_entry **cell = grid->cells[row * grid->columns + column];
+      /* the order in a cell does not matter, so the last one takes its place */
+      for(size_t i = 0; i < array_len(cell); i++) {
+        if(cell[i] != entry) continue;
+        cell[i] = cell[array_len(cell) - 1];
+        array_len(cell)--;
+        break;
+      }
+    }
+  }
+}
+
+struct spatial_entry **
+spatial_grid_cell_at(struct mwc_output *output, double lx, double ly) {
+  spatial_flush();
+
+  struct wlr_box box;
+  wlr_output_layout_get_box(server.output_layout, output->wlr_output, &box);
+  if(wlr_box_empty(&box)) return NULL;
+
+  struct spatial_grid *grid = &output->spatial;
+  if(grid->cells == NULL || !wlr_box_equal(&box, &grid->box)) {
+    spatial_grid_rebuild(grid, &box);
+  }
+
+  if(!wlr_box_contains_point(&grid->box, lx, ly)) return NULL;
+
+  int32_t column = ((int32_t)floor(lx) - grid->box.x) / SPATIAL_CELL_SIZE;
+  int32_t row = ((int32_t)floor(ly) - grid->box.y) / SPATIAL_CELL_SIZE;
+  return grid->cells[row * grid->columns + column];
+}
+
+/* the trees whose children are all toplevels or layer surfaces */
+bool
+spatial_tree_is_indexed(struct wlr_scene_node *node) {
+  return node == &server.background_tree->node
+    || node == &server.bottom_tree->node
+    || node == &server.tiled_tree->node
+    || node == &server.floating_tree->node
+    || node == &server.top_tree->node
+    || node == &server.fullscreen_tree->node
+    || node == &server.overlay_tree->node;
+}
+
+struct wlr_scene_node *
+spatial_tree_node_at(struct wlr_scene_tree *tree, struct spatial_entry **candidates,
+                     size_t count, double lx, double ly, double *sx, double *sy) {
+  size_t in_tree = 0;
+  struct spatial_entry *last = NULL;
+  for(size_t i = 0; i < count; i++) {
+    if(candidates[i]->node->parent != tree) continue;
+    in_tree++;
+    last = candidates[i];
+  }
+
+  if(in_tree == 0) return NULL;
+  if(in_tree == 1) return wlr_scene_node_at(last->node, lx, ly, sx, sy);
+
+  /* overlapping toplevels, we go through the children topmost first like the
+   * scene would, but only descend into the ones under the point */
+  struct wlr_scene_node *child;
+  wl_list_for_each_reverse(child, &tree->children, link) {
+    for(size_t i = 0; i < count; i++) {
+      if(candidates[i]->node != child) continue;
+
+      struct wlr_scene_node *node = wlr_scene_node_at(child, lx, ly, sx, sy);
+      if(node != NULL) return node;
+      if(--in_tree == 0) return NULL;
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+/* same as wlr_scene_node_at() on the whole scene, but only the subtrees
+ * whose box contains the point are walked */
+struct wlr_scene_node *
+spatial_node_at(double lx, double ly, double *sx, double *sy) {
+  struct wlr_scene_node *root = &server.scene->tree.node;
+
+  /* popups reach outside of their parents, the lock and drag icons are above
+   * everything; they are all short lived, so the scene can walk them */
+  if(server.popup_count > 0 || server.lock != NULL || server.drag_active) {
+    return wlr_scene_node_at(root, lx, ly, sx, sy);
+  }
+
+  struct wlr_output *wlr_output = wlr_output_layout_output_at(server.output_layout, lx, ly);
+  if(wlr_output == NULL) {
+    return wlr_scene_node_at(root, lx, ly, sx, sy);
+  }
+
+  struct spatial_entry **cell = spatial_grid_cell_at(wlr_output->data, lx, ly);
+  if(cell == NULL) {
+    return wlr_scene_node_at(root, lx, ly, sx, sy);
+  }
+
+  struct spatial_entry *candidates[SPATIAL_CANDIDATES_MAX];
+  size_t count = 0;
+  for(size_t i = 0; i < array_len(cell); i++) {
+    struct spatial_entry *entry = cell[i];
+    if(entry->node == NULL || !entry->node->enabled) continue;
+    if(!wlr_box_contains_point(&entry->box, lx, ly)) continue;
+
+    if(count == SPATIAL_CANDIDATES_MAX) {
+      return wlr_scene_node_at(root, lx, ly, sx, sy);
+    }
+    candidates[count++] = entry;
+  }
+
+  struct wlr_scene_node *child;
+  wl_list_for_each_reverse(child, &server.scene->tree.children, link) {
+    if(!child->enabled) continue;
+
+    struct wlr_scene_node *node;
+    if(spatial_tree_is_indexed(child)) {
+      node = spatial_tree_node_at(wlr_scene_tree_from_node(child), candidates, count,
+                                  lx, ly, sx, sy);
+    } else {
+      /* the blur nodes and the lock and drag icon trees, just a few nodes */
+      node = wlr_scene_node_at(child, lx, ly, sx, sy);
+    }
+    if(node != NULL) return node;
+  }
+
+  return NULL;
+}
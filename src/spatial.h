@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/util/box.h>
+
+/* with a hundred tiles on a 4k output a cell still holds only a few of them */
+#define SPATIAL_CELL_SIZE 128
+/* more than this many boxes under a single point and we let the scene walk it */
+#define SPATIAL_CANDIDATES_MAX 32
+
+struct mwc_something;
+struct mwc_output;
+struct wlr_scene_node;
+struct wlr_scene_tree;
+
+/* a toplevel or a layer surface, as far as hit testing is concerned */
+struct spatial_entry {
+  struct mwc_something *something;
+  /* root of what is hit tested, a child of one of the layer trees.
+   * toplevels only get one when they are mapped */
+  struct wlr_scene_node *node;
+  /* layout coords, covers everything enabled below node apart from popups */
+  struct wlr_box box;
+  /* the part of the layout a tiled toplevel takes, gaps included,
+   * as of the last layout pass; see layout_toplevel_at() */
+  struct wlr_box slot;
+  /* what the grids hold it under, box and slot together */
+  struct wlr_box indexed;
+
+  /* boxes are only recomputed when someone asks, so a client committing
+   * many times a frame costs a list insert each time */
+  bool dirty;
+  /* link in server.spatial_dirty */
+  struct wl_list dirty_link;
+  /* link in server.spatial_entries */
+  struct wl_list link;
+};
+
+/* uniform grid over the layout box of an output */
+struct spatial_grid {
+  /* the box it was built for, it is rebuilt when the output moves or changes mode */
+  struct wlr_box box;
+  int32_t columns;
+  int32_t rows;
+  /* columns * rows arrays of entries whose indexed box touches the cell */
+  struct spatial_entry ***cells;
+};
+
+void
+spatial_entry_init(struct spatial_entry *entry, struct mwc_something *something,
+                   struct wlr_scene_node *node);
+
+void
+spatial_entry_finish(struct spatial_entry *entry);
+
+void
+spatial_entry_set_node(struct spatial_entry *entry, struct wlr_scene_node *node);
+
+void
+spatial_entry_set_slot(struct spatial_entry *entry, struct wlr_box slot);
+
+void
+spatial_entry_mark_dirty(struct spatial_entry *entry);
+
+void
+spatial_node_extents(struct wlr_scene_node *node, int32_t x, int32_t y,
+                     struct wlr_box *extents);
+
+void
+spatial_flush(void);
+
+void
+spatial_grid_finish(struct spatial_grid *grid);
+
+void
+spatial_grid_rebuild(struct spatial_grid *grid, struct wlr_box *box);
+
+bool
+spatial_grid_range(struct spatial_grid *grid, struct spatial_entry *entry,
+                   int32_t *x1, int32_t *y1, int32_t *x2, int32_t *y2);
+
+void
+spatial_grid_insert(struct spatial_grid *grid, struct spatial_entry *entry);
+
+void
+spatial_grid_remove(struct spatial_grid *grid, struct spatial_entry *entry);
+
+struct spatial_entry **
+spatial_grid_cell_at(struct mwc_output *output, double lx, double ly);
+
+bool
+spatial_tree_is_indexed(struct wlr_scene_node *node);
+
+struct wlr_scene_node *
+spatial_tree_node_at(struct wlr_scene_tree *tree, struct spatial_entry **candidates,
+                     size_t count, double lx, double ly, double *sx, double *sy);
+
+struct wlr_scene_node *
+spatial_node_at(double lx, double ly, double *sx, double *sy);
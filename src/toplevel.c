@@ -14,6 +14,7 @@
 #include "helpers.h"
 #include "layer_surface.h"
 #include "pointer.h"
+#include "transaction.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -21,6 +22,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wayland-util.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_foreign_toplevel_management_v1.h>
@@ -45,7 +47,14 @@ server_handle_new_toplevel(struct wl_listener *listener, void *data) {
   toplevel->active_opacity = server.config->active_opacity;
   toplevel->inactive_opacity = server.config->inactive_opacity;
 
+  toplevel->id = ++server.last_toplevel_id;
   toplevel->workspace = server.active_workspace;
+  toplevel->effects_dirty = MWC_DIRTY_ALL;
+  wl_list_init(&toplevel->active_link);
+  wl_list_init(&toplevel->transaction_link);
+  wl_list_init(&toplevel->metadata_link);
+  /* it gets a node to hit test once it is mapped */
+  spatial_entry_init(&toplevel->spatial, &toplevel->something, NULL);
 
   wlr_fractional_scale_v1_notify_scale(toplevel->xdg_toplevel->base->surface,
                                        toplevel->workspace->output->wlr_output->scale);
@@ -98,15 +107,7 @@ toplevel_handle_initial_commit(struct mwc_toplevel *toplevel) {
     /* we lookup window rules and send a configure */
     toplevel_floating_size(toplevel, &width, &height);
   } else {
-    struct mwc_output *output = toplevel->workspace->output;
-
-    uint32_t master_count = wl_list_length(&toplevel->workspace->masters);
-    uint32_t slave_count = wl_list_length(&toplevel->workspace->slaves);
-    if(master_count < server.config->master_count) {
-      calculate_masters_dimensions(output, master_count + 1, slave_count, &width, &height);
-    } else {
-      calculate_slaves_dimensions(output, slave_count + 1, &width, &height);
-    }
+    layout_predict_size(toplevel->workspace, &width, &height);
   }
 
   wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, width, height);
@@ -123,11 +124,17 @@ toplevel_handle_commit(struct wl_listener *listener, void *data) {
 
   if(!toplevel->xdg_toplevel->base->initialized) return;
 
+  /* buffers and subsurfaces might have moved or changed size */
+  spatial_entry_mark_dirty(&toplevel->spatial);
+
   if(toplevel->xdg_toplevel->base->initial_commit) {
     toplevel_handle_initial_commit(toplevel);
     return;
   }
 
+  /* the surface size, its geometry or subsurfaces might have changed */
+  toplevel_mark_effects_dirty(toplevel, MWC_DIRTY_GEOMETRY);
+
   if(toplevel->resizing) {
     toplevel_commit(toplevel);
     return;
@@ -150,6 +157,11 @@ toplevel_handle_commit(struct wl_listener *listener, void *data) {
     }
   }
 
+  if(toplevel_in_transaction(toplevel)) {
+    transaction_toplevel_ready(toplevel);
+    return;
+  }
+
   toplevel_commit(toplevel);
 }
 
@@ -160,14 +172,11 @@ toplevel_handle_map(struct wl_listener *listener, void *data) {
 
   if(toplevel->floating) {
     wl_list_insert(&toplevel->workspace->floating_toplevels, &toplevel->link);
+    ipc_invalidate(IPC_QUERY_TOPLEVELS);
     toplevel->scene_tree = wlr_scene_xdg_surface_create(server.floating_tree,
                                                         toplevel->xdg_toplevel->base);
   } else {
-    if(wl_list_length(&toplevel->workspace->masters) < server.config->master_count) {
-      wl_list_insert(toplevel->workspace->masters.prev, &toplevel->link);
-    } else {
-      wl_list_insert(toplevel->workspace->slaves.prev, &toplevel->link);
-    }
+    layout_append(toplevel);
 
     toplevel->scene_tree = wlr_scene_xdg_surface_create(server.tiled_tree,
                                                         toplevel->xdg_toplevel->base);
@@ -194,6 +203,7 @@ toplevel_handle_map(struct wl_listener *listener, void *data) {
    * be keeping mwc_something in user data field, which is a union of all possible
    * 'things' we can have on the screen */
   toplevel->scene_tree->node.data = &toplevel->something;
+  spatial_entry_set_node(&toplevel->spatial, &toplevel->scene_tree->node);
 
   focus_toplevel(toplevel);
 
@@ -223,6 +233,7 @@ toplevel_handle_map(struct wl_listener *listener, void *data) {
   }
 
   toplevel_commit(toplevel);
+  ipc_toplevel_map(toplevel);
 }
 
 void
@@ -232,6 +243,15 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
 
   struct mwc_workspace *workspace = toplevel->workspace;
 
+  ipc_invalidate(IPC_QUERY_TOPLEVELS);
+  ipc_toplevel_unmap(toplevel);
+
+  wl_list_remove(&toplevel->active_link);
+  wl_list_init(&toplevel->active_link);
+
+  /* the scene tree is made anew on the next map */
+  transaction_drop_saved_buffers(toplevel);
+
   /* reset the cursor mode if the grabbed toplevel was unmapped. */
   /* if its the one focus should be returned to, remove it */
   if(toplevel == server.prev_focused) {
@@ -272,6 +292,7 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
       if(t == toplevel) continue;
       wlr_scene_node_set_enabled(&t->scene_tree->node, true);
     }
+    workspace_schedule_dirty_toplevels(workspace);
   }
 
   if(toplevel->floating) {
@@ -303,10 +324,9 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
 
   if(toplevel_is_master(toplevel)) {
     /* we find a new master to replace him if possible */
-    if(!wl_list_empty(&workspace->slaves)) {
+    if(workspace->slave_count > 0) {
       struct mwc_toplevel *s = wl_container_of(workspace->slaves.prev, s, link);
-      wl_list_remove(&s->link);
-      wl_list_insert(workspace->masters.prev, &s->link);
+      layout_promote_slave(s);
     }
     if(toplevel == server.focused_toplevel) {
       /* we want to give focus to some other toplevel */
@@ -331,7 +351,7 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
     }
 
     /* we finally remove him from the list */
-    wl_list_remove(&toplevel->link);
+    layout_remove(toplevel);
   } else {
     if(toplevel == server.focused_toplevel) {
       /* we want to give focus to some other toplevel */
@@ -349,7 +369,7 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
       focus_toplevel(t);
     }
 
-    wl_list_remove(&toplevel->link);
+    layout_remove(toplevel);
   }
 
   layout_set_pending_state(toplevel->workspace);
@@ -369,7 +389,14 @@ toplevel_handle_destroy(struct wl_listener *listener, void *data) {
   wl_list_remove(&toplevel->request_resize.link);
   wl_list_remove(&toplevel->request_maximize.link);
   wl_list_remove(&toplevel->request_fullscreen.link);
-
+  wl_list_remove(&toplevel->set_app_id.link);
+  wl_list_remove(&toplevel->set_title.link);
+  wl_list_remove(&toplevel->active_link);
+  wl_list_remove(&toplevel->metadata_link);
+  spatial_entry_finish(&toplevel->spatial);
+
+  free(toplevel->app_id);
+  free(toplevel->title);
   free(toplevel);
 }
 
@@ -386,6 +413,8 @@ toplevel_start_move(struct mwc_toplevel *toplevel) {
 
   server.grabbed_toplevel = toplevel;
   server.cursor_mode = MWC_CURSOR_MOVE;
+  /* it is out of the lists until dropped */
+  ipc_invalidate(IPC_QUERY_TOPLEVELS);
 
   server.grab_x = server.cursor->x;
   server.grab_y = server.cursor->y;
@@ -401,11 +430,10 @@ toplevel_start_move(struct mwc_toplevel *toplevel) {
     wl_list_remove(&toplevel->link);
   } else {
     bool is_master = toplevel_is_master(toplevel);
-    wl_list_remove(&toplevel->link);
-    if(is_master && !wl_list_empty(&toplevel->workspace->slaves)) {
+    layout_remove(toplevel);
+    if(is_master && toplevel->workspace->slave_count > 0) {
       struct mwc_toplevel *last = wl_container_of(toplevel->workspace->slaves.prev, last, link);
-      wl_list_remove(&last->link);
-      wl_list_insert(toplevel->workspace->masters.prev, &last->link);
+      layout_promote_slave(last);
     }
 
     layout_set_pending_state(toplevel->workspace);
@@ -485,106 +513,134 @@ toplevel_handle_request_fullscreen(struct wl_listener *listener, void *data) {
 
 void
 toplevel_recheck_opacity_rules(struct mwc_toplevel *toplevel) {
+  double inactive_opacity = server.config->inactive_opacity;
+  double active_opacity = server.config->active_opacity;
+
   /* check if it satisfies some window rule */
-  struct window_rule_opacity *w;
-  bool set = false;
-  wl_list_for_each(w, &server.config->window_rules.opacity, link) {
-    if(toplevel_matches_window_rule(toplevel, &w->condition)) {
-      toplevel->inactive_opacity = w->inactive_value;
-      toplevel->active_opacity = w->active_value;
-      set = true;
-      break;
-    }
+  struct window_rule_opacity *w = toplevel_get_window_rules(toplevel)->opacity;
+  if(w != NULL) {
+    inactive_opacity = w->inactive_value;
+    active_opacity = w->active_value;
   }
 
-  if(!set) {
-    toplevel->inactive_opacity = server.config->inactive_opacity;
-    toplevel->active_opacity = server.config->active_opacity;
+  if(toplevel->inactive_opacity != inactive_opacity
+     || toplevel->active_opacity != active_opacity) {
+    toplevel->inactive_opacity = inactive_opacity;
+    toplevel->active_opacity = active_opacity;
+    toplevel_mark_effects_dirty(toplevel, MWC_DIRTY_OPACITY);
   }
 }
 
 void
 toplevel_handle_set_app_id(struct wl_listener *listener, void *data) {
   struct mwc_toplevel *toplevel = wl_container_of(listener, toplevel, set_app_id);
-
-  toplevel_recheck_opacity_rules(toplevel);
-
-  wlr_foreign_toplevel_handle_v1_set_app_id(toplevel->foreign_toplevel_handle,
-                                            toplevel->xdg_toplevel->app_id);
-
-  if(toplevel == server.focused_toplevel) {
-    ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
-  }
+  toplevel_mark_metadata_dirty(toplevel, MWC_METADATA_APP_ID);
 }
 
 void
 toplevel_handle_set_title(struct wl_listener *listener, void *data) {
   struct mwc_toplevel *toplevel = wl_container_of(listener, toplevel, set_title);
+  toplevel_mark_metadata_dirty(toplevel, MWC_METADATA_TITLE);
+}
 
-  toplevel_recheck_opacity_rules(toplevel);
-
-  wlr_foreign_toplevel_handle_v1_set_title(toplevel->foreign_toplevel_handle,
-                                           toplevel->xdg_toplevel->title);
+/* terminals and browsers change titles many times a second, so the changes
+ * are only collected here and handled once in the next frame. a disabled output
+ * never gets one, so the timer flushes them if the frame does not come */
+void
+toplevel_mark_metadata_dirty(struct mwc_toplevel *toplevel, uint32_t mask) {
+  if(wl_list_empty(&server.metadata_dirty_toplevels)) {
+    /* not pushed back by later changes, so a stream of them still gets out */
+    wl_event_source_timer_update(server.metadata_timer, TOPLEVEL_METADATA_FLUSH_MS);
+  }
 
-  if(toplevel == server.focused_toplevel) {
-    ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
+  if(toplevel->metadata_dirty == 0) {
+    wl_list_insert(server.metadata_dirty_toplevels.prev, &toplevel->metadata_link);
   }
+  toplevel->metadata_dirty |= mask;
+
+  wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
 }
 
+int
+toplevel_handle_metadata_timer(void *data) {
+  toplevels_flush_metadata();
+  return 0;
+}
+
+/* replaces *old with a copy of new, returns false if they were the same */
 bool
-toplevel_matches_window_rule(struct mwc_toplevel *toplevel,
-                             struct window_rule_regex *condition) {
-  char *app_id = toplevel->xdg_toplevel->app_id;
-  char *title = toplevel->xdg_toplevel->title;
-
-  bool matches_app_id;
-  if(condition->has_app_id_regex) {
-    if(app_id == NULL) {
-      matches_app_id = false;
-    } else {
-      matches_app_id = regexec(&condition->app_id_regex, app_id, 0, NULL, 0) == 0;
+toplevel_update_string(char **old, const char *new) {
+  if(*old == NULL && new == NULL) return false;
+  if(*old != NULL && new != NULL && strcmp(*old, new) == 0) return false;
+
+  free(*old);
+  *old = new == NULL ? NULL : strdup(new);
+  return true;
+}
+
+void
+toplevels_flush_metadata(void) {
+  /* this runs every frame, so only touch the timer if there is something to flush */
+  if(wl_list_empty(&server.metadata_dirty_toplevels)) return;
+  wl_event_source_timer_update(server.metadata_timer, 0);
+
+  struct mwc_toplevel *toplevel, *tmp;
+  wl_list_for_each_safe(toplevel, tmp, &server.metadata_dirty_toplevels, metadata_link) {
+    wl_list_remove(&toplevel->metadata_link);
+    wl_list_init(&toplevel->metadata_link);
+
+    bool app_id_changed = toplevel->metadata_dirty & MWC_METADATA_APP_ID
+      && toplevel_update_string(&toplevel->app_id, toplevel->xdg_toplevel->app_id);
+    bool title_changed = toplevel->metadata_dirty & MWC_METADATA_TITLE
+      && toplevel_update_string(&toplevel->title, toplevel->xdg_toplevel->title);
+    toplevel->metadata_dirty = 0;
+
+    if(!app_id_changed && !title_changed) continue;
+
+    toplevel_recheck_opacity_rules(toplevel);
+    ipc_invalidate(IPC_QUERY_TOPLEVELS);
+
+    if(app_id_changed) {
+      wlr_foreign_toplevel_handle_v1_set_app_id(toplevel->foreign_toplevel_handle,
+                                                toplevel->app_id);
+    }
+    if(title_changed) {
+      wlr_foreign_toplevel_handle_v1_set_title(toplevel->foreign_toplevel_handle,
+                                               toplevel->title);
     }
-  } else {
-    matches_app_id = true;
-  }
 
-  bool matches_title;
-  if(condition->has_title_regex) {
-    if(title == NULL) {
-      matches_title = false;
-    } else {
-      matches_title = regexec(&condition->title_regex, title, 0, NULL, 0) == 0;
+    if(toplevel == server.focused_toplevel) {
+      ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
     }
-  } else {
-    matches_title = true;
   }
+}
 
-  return matches_app_id && matches_title;
+struct window_rule_match *
+toplevel_get_window_rules(struct mwc_toplevel *toplevel) {
+  return window_rules_match(server.config, toplevel->xdg_toplevel->app_id,
+                            toplevel->xdg_toplevel->title);
 }
 
 void
 toplevel_floating_size(struct mwc_toplevel *toplevel, uint32_t *width, uint32_t *height) {
-  struct window_rule_size *w;
-  wl_list_for_each(w, &server.config->window_rules.size, link) {
-    if(toplevel_matches_window_rule(toplevel, &w->condition)) {
-      if(w->relative_width) {
-        *width = toplevel->workspace->output->usable_area.width * w->width / 100;
-      } else {
-        *width = w->width;
-      }
-
-      if(w->relative_height) {
-        *height = toplevel->workspace->output->usable_area.height * w->height / 100;
-      } else {
-        *height = w->height;
-      }
+  struct window_rule_size *w = toplevel_get_window_rules(toplevel)->size;
+  if(w == NULL) {
+    *width = 0;
+    *height = 0;
+    return;
+  }
 
-      return;
-    }
+  if(w->relative_width) {
+    *width = toplevel->workspace->output->usable_area.width * w->width / 100;
+  } else {
+    *width = w->width;
   }
 
-  *width = 0;
-  *height = 0;
+  if(w->relative_height) {
+    *height = toplevel->workspace->output->usable_area.height * w->height / 100;
+  } else {
+    *height = w->height;
+  }
 }
 
 bool
@@ -601,14 +657,7 @@ toplevel_should_float(struct mwc_toplevel *toplevel) {
     || toplevel->xdg_toplevel->parent != NULL;
   if(b) return true;
 
-  struct window_rule_float *w;
-  wl_list_for_each(w, &server.config->window_rules.floating, link) {
-    if(toplevel_matches_window_rule(toplevel, &w->condition)) {
-      return true;
-    }
-  }
-
-  return false;
+  return toplevel_get_window_rules(toplevel)->floating;
 }
 
 struct mwc_toplevel *
@@ -635,6 +684,8 @@ cursor_jump_focused_toplevel(void) {
   wlr_cursor_warp(server.cursor, NULL,
                   toplevel->scene_tree->node.x + geo_box.x + toplevel->current.width / 2.0,
                   toplevel->scene_tree->node.y + geo_box.y + toplevel->current.height / 2.0);
+  /* the motion from before the jump must not take focus away from the toplevel */
+  server.cursor_motion_pending = false;
 
   struct timespec now;
   clock_gettime(CLOCK_MONOTONIC, &now);
@@ -652,6 +703,22 @@ toplevel_set_pending_state(struct mwc_toplevel *toplevel, uint32_t x, uint32_t y
     .height = height,
   };
 
+  /* this is a change from outside of the layout, e.g. going fullscreen */
+  bool collecting = toplevel->workspace->transaction.collecting;
+  if(!collecting) {
+    transaction_remove_toplevel(toplevel);
+  }
+
+  /* nothing changes, so neither the client nor the renderer need to know */
+  if(wlr_box_equal(&toplevel->pending, &pending)
+     && (toplevel->dirty || wlr_box_equal(&toplevel->current, &pending))) return;
+
+  /* the client is already drawing this size, the new position gets
+   * applied together with it once it commits */
+  bool size_in_flight = toplevel->dirty
+    && toplevel->pending.width == pending.width
+    && toplevel->pending.height == pending.height;
+
   toplevel->pending = pending;
 
   if(!server.config->animations || toplevel == server.grabbed_toplevel
@@ -662,36 +729,56 @@ toplevel_set_pending_state(struct mwc_toplevel *toplevel, uint32_t x, uint32_t y
     toplevel->animation.initial = toplevel->current;
   }
 
-  if(toplevel->current.width == toplevel->pending.width
+  if(size_in_flight) {
+    if(collecting) {
+      transaction_add_toplevel(toplevel, !toplevel->transaction_ready);
+    }
+    return;
+  }
+
+  /* if a configure is in flight we need a new one even for the current size,
+   * otherwise the client would end up with the stale one */
+  if(!toplevel->dirty
+     && toplevel->current.width == toplevel->pending.width
      && toplevel->current.height == toplevel->pending.height) {
-    toplevel_commit(toplevel);
+    /* only moves, which can go as soon as the rest of the transaction does */
+    if(collecting) {
+      transaction_add_toplevel(toplevel, false);
+    } else {
+      toplevel_commit(toplevel);
+    }
     return;
   };
 
   toplevel->configure_serial = wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel,
                                                          width, height);
   toplevel->dirty = true;
+
+  if(collecting) {
+    transaction_add_toplevel(toplevel, true);
+  }
 }
 
 void
 toplevel_commit(struct mwc_toplevel *toplevel) {
   toplevel->dirty = false;
   toplevel->current = toplevel->pending;
+  transaction_drop_saved_buffers(toplevel);
 
   if(toplevel->animation.should_animate) {
     if(toplevel->animation.running) {
       /* if there is already an animation running, we start this one from the current state */
       toplevel->animation.initial = toplevel->animation.current;
     }
-    toplevel->animation.passed_frames = 0;
-    toplevel->animation.total_frames = server.config->animation_duration
-      / output_frame_duration_ms(toplevel->workspace->output);
+    toplevel->animation.start = 0;
+    toplevel->animation.duration = server.config->animation_duration;
 
     toplevel->animation.running = true;
     toplevel->animation.should_animate = false;
   }
 
-  wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
+  toplevel_mark_effects_dirty(toplevel, MWC_DIRTY_GEOMETRY);
+  ipc_toplevel_changed();
 }
 
 void
@@ -712,6 +799,8 @@ toplevel_set_fullscreen(struct mwc_toplevel *toplevel) {
 
   workspace->fullscreen_toplevel = toplevel;
   toplevel->fullscreen = true;
+  ipc_toplevel_changed();
+  toplevel->effects_dirty |= MWC_DIRTY_FULLSCREEN;
 
   wlr_xdg_toplevel_set_fullscreen(toplevel->xdg_toplevel, true);
   toplevel_set_pending_state(toplevel, output_box.x, output_box.y,
@@ -747,6 +836,8 @@ toplevel_unset_fullscreen(struct mwc_toplevel *toplevel) {
 
   workspace->fullscreen_toplevel = NULL;
   toplevel->fullscreen = false;
+  ipc_toplevel_changed();
+  toplevel_mark_effects_dirty(toplevel, MWC_DIRTY_FULLSCREEN);
 
   wlr_xdg_toplevel_set_fullscreen(toplevel->xdg_toplevel, false);
 
@@ -776,6 +867,7 @@ toplevel_unset_fullscreen(struct mwc_toplevel *toplevel) {
 
   layers_under_fullscreen_set_enabled(workspace->output, true);
   layout_set_pending_state(workspace);
+  workspace_schedule_dirty_toplevels(workspace);
   wlr_foreign_toplevel_handle_v1_set_fullscreen(toplevel->foreign_toplevel_handle, false);
 }
 
@@ -859,8 +951,8 @@ unfocus_focused_toplevel(void) {
   ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
   wlr_foreign_toplevel_handle_v1_set_activated(toplevel->foreign_toplevel_handle, false);
 
-  /* we schedule a frame in order for borders to be redrawn */
-  wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
+  /* borders and opacity have to be redrawn */
+  toplevel_mark_effects_dirty(toplevel, MWC_DIRTY_FOCUS);
 }
 
 void
@@ -879,6 +971,7 @@ focus_toplevel(struct mwc_toplevel *toplevel) {
   if(prev_toplevel != NULL) {
     wlr_xdg_toplevel_set_activated(prev_toplevel->xdg_toplevel, false);
     wlr_foreign_toplevel_handle_v1_set_activated(toplevel->foreign_toplevel_handle, false);
+    toplevel_mark_effects_dirty(prev_toplevel, MWC_DIRTY_FOCUS);
   }
 
   server.focused_toplevel = toplevel;
@@ -886,6 +979,7 @@ focus_toplevel(struct mwc_toplevel *toplevel) {
   if(toplevel->floating) {
     wl_list_remove(&toplevel->link);
     wl_list_insert(&toplevel->workspace->floating_toplevels, &toplevel->link);
+    ipc_invalidate(IPC_QUERY_TOPLEVELS);
   }
 
 	wlr_xdg_toplevel_set_activated(toplevel->xdg_toplevel, true);
@@ -902,8 +996,8 @@ focus_toplevel(struct mwc_toplevel *toplevel) {
   ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
   wlr_foreign_toplevel_handle_v1_set_activated(toplevel->foreign_toplevel_handle, true);
 
-  /* we schedule a frame in order for borders to be redrawn */
-  wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
+  /* borders and opacity have to be redrawn */
+  toplevel_mark_effects_dirty(toplevel, MWC_DIRTY_FOCUS);
 }
 
 
@@ -1037,11 +1131,7 @@ toplevel_tiled_insert_into_layout(struct mwc_toplevel *toplevel, uint32_t x, uin
   struct mwc_toplevel *under_cursor = layout_toplevel_at(workspace, x, y);
 
   if(under_cursor == NULL) {
-    if(wl_list_length(&workspace->masters) < server.config->master_count) {
-      wl_list_insert(workspace->masters.prev, &toplevel->link);
-    } else {
-      wl_list_insert(workspace->slaves.prev, &toplevel->link);
-    }
+    layout_append(toplevel);
   } else {
     bool on_left_side = x <= under_cursor->current.x + under_cursor->current.width / 2;
     bool on_top_side = y <= under_cursor->current.y + under_cursor->current.height / 2;
@@ -1051,18 +1141,16 @@ toplevel_tiled_insert_into_layout(struct mwc_toplevel *toplevel, uint32_t x, uin
      *   - its last master and there are some slaves
      *   - cursor is on left (top) */
     if((under_cursor_is_master && &under_cursor->link == workspace->masters.prev
-       && wl_list_length(&workspace->slaves) > 0)
+       && workspace->slave_count > 0)
        || (under_cursor_is_master && on_left_side)
        || (!under_cursor_is_master && on_top_side)) {
-      wl_list_insert(under_cursor->link.prev, &toplevel->link);
+      layout_insert(toplevel, under_cursor->layout_role, under_cursor->link.prev);
     } else {
-      wl_list_insert(&under_cursor->link, &toplevel->link);
+      layout_insert(toplevel, under_cursor->layout_role, &under_cursor->link);
     }
 
-    if(wl_list_length(&workspace->masters) > server.config->master_count) {
-      struct mwc_toplevel *last = wl_container_of(workspace->masters.prev, last, link);
-      wl_list_remove(&last->link);
-      wl_list_insert(workspace->slaves.prev, &last->link);
+    if(workspace->master_count > server.config->master_count) {
+      layout_demote_last_master(workspace);
     }
   }
 }
@@ -6,6 +6,7 @@
 #include "mwc.h"
 #include "config.h"
 #include "something.h"
+#include "spatial.h"
 
 #include <stdint.h>
 #include <wlr/types/wlr_xdg_shell.h>
@@ -13,6 +14,10 @@
 
 struct mwc_toplevel {
   struct wl_list link;
+  /* stable for the whole life of the toplevel, used by the ipc */
+  uint32_t id;
+  /* link in the active_toplevels of the output it is drawn on */
+  struct wl_list active_link;
   struct wlr_xdg_toplevel *xdg_toplevel;
   struct mwc_workspace *workspace;
 
@@ -21,9 +26,14 @@ struct mwc_toplevel {
   struct wlr_scene_shadow *shadow;
 
   struct mwc_something something;
+  struct spatial_entry spatial;
 
   bool floating;
   bool fullscreen;
+  /* none if floating or not in the layout, e.g. when grabbed */
+  enum mwc_layout_role layout_role;
+  /* position among the tiled toplevels, masters first, as of the last layout pass */
+  uint32_t layout_index;
   /* if a floating toplevel becomes fullscreen, we keep its previous state here */
   struct wlr_box prev_geometry;
 
@@ -31,6 +41,12 @@ struct mwc_toplevel {
 
   uint32_t configure_serial;
   bool dirty;
+  /* link in the transaction of its workspace, see transaction.h */
+  struct wl_list transaction_link;
+  /* acked and only waiting for the rest of the transaction */
+  bool transaction_ready;
+  /* what was on screen when it started waiting, shown until it is committed */
+  struct wlr_scene_tree *saved_tree;
 
   double inactive_opacity;
   double active_opacity;
@@ -41,9 +57,21 @@ struct mwc_toplevel {
   struct wlr_box pending;
 
   struct mwc_animation animation;
+  /* mask of enum mwc_effects_dirty */
+  uint32_t effects_dirty;
 
   struct wlr_foreign_toplevel_handle_v1 *foreign_toplevel_handle;
 
+  /* mask of enum mwc_metadata_dirty, handled once per frame */
+  uint32_t metadata_dirty;
+  /* link in server.metadata_dirty_toplevels */
+  struct wl_list metadata_link;
+  /* app_id and title as of the last time they were handled */
+  char *app_id;
+  char *title;
+
+  struct ipc_toplevel_state ipc_state;
+
   struct wl_listener map;
   struct wl_listener unmap;
   struct wl_listener commit;
@@ -56,9 +84,17 @@ struct mwc_toplevel {
   struct wl_listener set_title;
 };
 
+/* how long title and app_id changes wait for a frame before they are flushed anyway */
+#define TOPLEVEL_METADATA_FLUSH_MS 16
+
 #define X(t) ((t)->scene_tree->node.x)
 #define Y(t) ((t)->scene_tree->node.y)
 
+enum mwc_metadata_dirty {
+  MWC_METADATA_APP_ID = 1 << 0,
+  MWC_METADATA_TITLE = 1 << 1,
+};
+
 struct mwc_token {
   struct wlr_xdg_activation_token_v1 *wlr_token;
 
@@ -113,12 +149,20 @@ toplevel_handle_set_app_id(struct wl_listener *listener, void *data);
 void
 toplevel_handle_set_title(struct wl_listener *listener, void *data);
 
+void
+toplevel_mark_metadata_dirty(struct mwc_toplevel *toplevel, uint32_t mask);
+
+void
+toplevels_flush_metadata(void);
+
+int
+toplevel_handle_metadata_timer(void *data);
+
 bool
 toplevel_position_changed(struct mwc_toplevel *toplevel);
 
-bool
-toplevel_matches_window_rule(struct mwc_toplevel *toplevel,
-                             struct window_rule_regex *condition);
+struct window_rule_match *
+toplevel_get_window_rules(struct mwc_toplevel *toplevel);
 
 void
 toplevel_floating_size(struct mwc_toplevel *toplevel, uint32_t *width, uint32_t *height);
@@ -0,0 +1,263 @@
+#include <scenefx/types/wlr_scene.h>
+
+#include "transaction.h"
+
+#include "mwc.h"
+#include "output.h"
+#include "toplevel.h"
+#include "workspace.h"
+
+#include <wlr/util/log.h>
+
+extern struct mwc_server server;
+
+bool
+toplevel_in_transaction(struct mwc_toplevel *toplevel) {
+  return !wl_list_empty(&toplevel->transaction_link);
+}
+
+void
+transaction_unlink(struct mwc_toplevel *toplevel) {
+  wl_list_remove(&toplevel->transaction_link);
+  wl_list_init(&toplevel->transaction_link);
+}
+
+void
+iter_scene_buffer_save(struct wlr_scene_buffer *buffer, int sx, int sy, void *data) {
+  struct wlr_scene_tree *saved_tree = data;
+  if(buffer->buffer == NULL) return;
+
+  /* a copy of the buffer as it is shown now, the scene keeps the wlr_buffer locked
+   * so the client can not take it away from under us */
+  struct wlr_scene_buffer *saved = wlr_scene_buffer_create(saved_tree, NULL);
+  if(saved == NULL) return;
+
+  wlr_scene_node_set_position(&saved->node, sx, sy);
+  wlr_scene_buffer_set_source_box(saved, &buffer->src_box);
+  wlr_scene_buffer_set_dest_size(saved, buffer->dst_width, buffer->dst_height);
+  wlr_scene_buffer_set_transform(saved, buffer->transform);
+  wlr_scene_buffer_set_opaque_region(saved, &buffer->opaque_region);
+  wlr_scene_buffer_set_filter_mode(saved, buffer->filter_mode);
+  wlr_scene_buffer_set_opacity(saved, buffer->opacity);
+  wlr_scene_buffer_set_corner_radius(saved, buffer->corner_radius, buffer->corners);
+  wlr_scene_buffer_set_backdrop_blur(saved, buffer->backdrop_blur);
+  wlr_scene_buffer_set_backdrop_blur_optimized(saved, buffer->backdrop_blur_optimized);
+  wlr_scene_buffer_set_backdrop_blur_ignore_transparent(saved,
+                                                        buffer->backdrop_blur_ignore_transparent);
+  wlr_scene_buffer_set_buffer(saved, buffer->buffer);
+}
+
+/* children of the toplevel tree that hold its surfaces, border, shadow,
+ * popups and the saved buffers are not one of them */
+bool
+transaction_is_surface_node(struct mwc_toplevel *toplevel, struct wlr_scene_node *node) {
+  if(node->type != WLR_SCENE_NODE_TREE) return false;
+  if(toplevel->saved_tree != NULL && node == &toplevel->saved_tree->node) return false;
+
+  struct mwc_something *something = node->data;
+  return something == NULL || something->type != MWC_POPUP;
+}
+
+void
+transaction_save_buffers(struct mwc_toplevel *toplevel) {
+  /* the oldest one is what is on screen */
+  if(toplevel->saved_tree != NULL) return;
+
+  toplevel->saved_tree = wlr_scene_tree_create(toplevel->scene_tree);
+  if(toplevel->saved_tree == NULL) return;
+
+  struct wlr_scene_node *n;
+  wl_list_for_each(n, &toplevel->scene_tree->children, link) {
+    if(!transaction_is_surface_node(toplevel, n)) continue;
+    wlr_scene_node_for_each_buffer(n, iter_scene_buffer_save, toplevel->saved_tree);
+    wlr_scene_node_set_enabled(n, false);
+  }
+
+  /* above the border and the shadow, below the popups */
+  wlr_scene_node_lower_to_bottom(&toplevel->saved_tree->node);
+  if(toplevel->border != NULL) {
+    wlr_scene_node_lower_to_bottom(&toplevel->border->node);
+  }
+  if(toplevel->shadow != NULL) {
+    wlr_scene_node_lower_to_bottom(&toplevel->shadow->node);
+  }
+}
+
+void
+transaction_drop_saved_buffers(struct mwc_toplevel *toplevel) {
+  if(toplevel->saved_tree == NULL) return;
+
+  wlr_scene_node_destroy(&toplevel->saved_tree->node);
+  toplevel->saved_tree = NULL;
+
+  struct wlr_scene_node *n;
+  wl_list_for_each(n, &toplevel->scene_tree->children, link) {
+    if(!transaction_is_surface_node(toplevel, n)) continue;
+    wlr_scene_node_set_enabled(n, true);
+  }
+}
+
+/* the saved buffers stand in for the surfaces, so input over them goes to the main
+ * surface of the toplevel as if it was still shown. returns NULL if node is not
+ * one of them */
+struct mwc_toplevel *
+transaction_saved_buffer_at(struct wlr_scene_node *node, double lx, double ly,
+                            struct wlr_surface **surface, double *sx, double *sy) {
+  struct wlr_scene_tree *tree = node->parent;
+  if(tree == NULL || tree->node.parent == NULL) return NULL;
+
+  struct mwc_something *something = tree->node.parent->node.data;
+  if(something == NULL || something->type != MWC_TOPLEVEL) return NULL;
+
+  struct mwc_toplevel *toplevel = something->toplevel;
+  if(toplevel->saved_tree != tree) return NULL;
+
+  /* disabled nodes still have their position */
+  struct wlr_scene_node *n;
+  wl_list_for_each(n, &toplevel->scene_tree->children, link) {
+    if(!transaction_is_surface_node(toplevel, n)) continue;
+
+    int x, y;
+    wlr_scene_node_coords(n, &x, &y);
+    *surface = toplevel->xdg_toplevel->base->surface;
+    *sx = lx - x;
+    *sy = ly - y;
+    return toplevel;
+  }
+
+  return NULL;
+}
+
+void
+transaction_apply(struct mwc_workspace *workspace) {
+  struct mwc_transaction *transaction = &workspace->transaction;
+  struct mwc_output *output = workspace->output;
+
+  if(transaction->timeout_armed) {
+    wl_event_source_timer_update(transaction->timeout, 0);
+    transaction->timeout_armed = false;
+  }
+
+  /* everything lands in the same frame */
+  output->defer_frames = true;
+
+  struct mwc_toplevel *t, *tmp;
+  wl_list_for_each_safe(t, tmp, &transaction->toplevels, transaction_link) {
+    transaction_unlink(t);
+    t->transaction_ready = false;
+    toplevel_commit(t);
+  }
+  transaction->waiting = 0;
+
+  output->defer_frames = false;
+  if(output->frame_deferred) {
+    output->frame_deferred = false;
+    wlr_output_schedule_frame(output->wlr_output);
+  }
+}
+
+int
+transaction_handle_timeout(void *data) {
+  struct mwc_workspace *workspace = data;
+  struct mwc_transaction *transaction = &workspace->transaction;
+  transaction->timeout_armed = false;
+
+  wlr_log(WLR_DEBUG, "transaction on workspace %u timed out with %u toplevels not ready",
+          workspace->index, transaction->waiting);
+
+  /* the ones that are ready go now, the rest commit on their own once they ack */
+  struct mwc_toplevel *t, *tmp;
+  wl_list_for_each_safe(t, tmp, &transaction->toplevels, transaction_link) {
+    if(t->transaction_ready) continue;
+    transaction_unlink(t);
+  }
+
+  transaction_apply(workspace);
+  return 0;
+}
+
+void
+transaction_begin(struct mwc_workspace *workspace) {
+  workspace->transaction.collecting = true;
+}
+
+void
+transaction_end(struct mwc_workspace *workspace) {
+  struct mwc_transaction *transaction = &workspace->transaction;
+  transaction->collecting = false;
+
+  if(wl_list_empty(&transaction->toplevels)) return;
+
+  if(transaction->waiting == 0) {
+    transaction_apply(workspace);
+    return;
+  }
+
+  if(transaction->timeout == NULL) {
+    transaction->timeout = wl_event_loop_add_timer(server.wl_event_loop,
+                                                   transaction_handle_timeout, workspace);
+  }
+
+  /* the timeout is not pushed back if the layout changes again while waiting,
+   * so a stream of changes cannot hold everything back forever */
+  if(!transaction->timeout_armed) {
+    wl_event_source_timer_update(transaction->timeout, TRANSACTION_TIMEOUT_MS);
+    transaction->timeout_armed = true;
+  }
+}
+
+void
+transaction_add_toplevel(struct mwc_toplevel *toplevel, bool waiting) {
+  struct mwc_transaction *transaction = &toplevel->workspace->transaction;
+
+  if(!toplevel_in_transaction(toplevel)) {
+    wl_list_insert(transaction->toplevels.prev, &toplevel->transaction_link);
+    toplevel->transaction_ready = !waiting;
+    if(waiting) {
+      transaction->waiting++;
+      transaction_save_buffers(toplevel);
+    }
+    return;
+  }
+
+  if(waiting && toplevel->transaction_ready) {
+    toplevel->transaction_ready = false;
+    transaction->waiting++;
+    transaction_save_buffers(toplevel);
+  }
+}
+
+void
+transaction_toplevel_ready(struct mwc_toplevel *toplevel) {
+  struct mwc_transaction *transaction = &toplevel->workspace->transaction;
+  if(toplevel->transaction_ready) return;
+
+  toplevel->transaction_ready = true;
+  transaction->waiting--;
+
+  if(transaction->waiting == 0 && !transaction->collecting) {
+    transaction_apply(toplevel->workspace);
+  }
+}
+
+void
+transaction_remove_toplevel(struct mwc_toplevel *toplevel) {
+  if(!toplevel_in_transaction(toplevel)) return;
+
+  struct mwc_workspace *workspace = toplevel->workspace;
+  struct mwc_transaction *transaction = &workspace->transaction;
+
+  transaction_unlink(toplevel);
+  if(toplevel->transaction_ready) {
+    toplevel->transaction_ready = false;
+    toplevel_commit(toplevel);
+  } else {
+    transaction->waiting--;
+  }
+
+  /* the rest might have only been waiting on this one */
+  if(transaction->waiting == 0 && !transaction->collecting
+     && !wl_list_empty(&transaction->toplevels)) {
+    transaction_apply(workspace);
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+/* how long we wait for clients to ack before giving up on them */
+#define TRANSACTION_TIMEOUT_MS 200
+
+struct mwc_toplevel;
+struct mwc_workspace;
+struct wlr_scene_node;
+struct wlr_surface;
+
+/* holds back the new geometry of the tiled toplevels on a workspace until
+ * every client involved has acked its configure, so it is all applied at once.
+ * clients that ack early get the buffers they had shown in their place until then,
+ * see transaction_save_buffers() */
+struct mwc_transaction {
+  /* set while layout_set_pending_state() is running */
+  bool collecting;
+  struct wl_list toplevels;
+  /* members that still have not acked their configure */
+  uint32_t waiting;
+  struct wl_event_source *timeout;
+  bool timeout_armed;
+};
+
+void
+transaction_begin(struct mwc_workspace *workspace);
+
+void
+transaction_end(struct mwc_workspace *workspace);
+
+/* adds the toplevel if it is not in yet. if it got a new configure
+ * it is waiting again, even if it was already ready */
+void
+transaction_add_toplevel(struct mwc_toplevel *toplevel, bool waiting);
+
+/* called when the toplevel acked the configure it is waiting on */
+void
+transaction_toplevel_ready(struct mwc_toplevel *toplevel);
+
+/* takes the toplevel out of its transaction, its state is applied now
+ * if it was ready, otherwise once it acks on its own */
+void
+transaction_remove_toplevel(struct mwc_toplevel *toplevel);
+
+bool
+transaction_is_surface_node(struct mwc_toplevel *toplevel, struct wlr_scene_node *node);
+
+/* shows a copy of what the toplevel has on screen now instead of its surfaces,
+ * until transaction_drop_saved_buffers() */
+void
+transaction_save_buffers(struct mwc_toplevel *toplevel);
+
+void
+transaction_drop_saved_buffers(struct mwc_toplevel *toplevel);
+
+struct mwc_toplevel *
+transaction_saved_buffer_at(struct wlr_scene_node *node, double lx, double ly,
+                            struct wlr_surface **surface, double *sx, double *sy);
+
+bool
+toplevel_in_transaction(struct mwc_toplevel *toplevel);
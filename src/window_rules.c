@@ -0,0 +1,226 @@
+#include "window_rules.h"
+
+#include "config.h"
+#include "helpers.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+
+/* most window rules are just an app_id like "imv" or "^firefox$",
+ * so we only hand the ones that really need it to regexec */
+bool
+window_rule_pattern_compile(struct window_rule_pattern *pattern, const char *source) {
+  *pattern = (struct window_rule_pattern){0};
+  pattern->source = strdup(source);
+
+  if(strcmp(source, "_") == 0) {
+    pattern->kind = WINDOW_RULE_PATTERN_ANY;
+    return true;
+  }
+
+  const char *start = source;
+  size_t len = strlen(source);
+  bool anchored_start = false;
+  bool anchored_end = false;
+
+  if(len > 0 && start[0] == '^') {
+    anchored_start = true;
+    start++;
+    len--;
+  }
+  if(len > 0 && start[len - 1] == '$') {
+    anchored_end = true;
+    len--;
+  }
+  /* "^foo.*" and "^foo.*$" are just prefixes */
+  if(len >= 2 && start[len - 2] == '.' && start[len - 1] == '*') {
+    anchored_end = false;
+    len -= 2;
+  }
+
+  bool literal = true;
+  for(size_t i = 0; i < len; i++) {
+    if(strchr(".[]()*+?{}|^$\\", start[i]) != NULL) {
+      literal = false;
+      break;
+    }
+  }
+
+  if(literal) {
+    if(anchored_start && anchored_end) {
+      pattern->kind = WINDOW_RULE_PATTERN_EXACT;
+    } else if(anchored_start) {
+      pattern->kind = WINDOW_RULE_PATTERN_PREFIX;
+    } else if(anchored_end) {
+      pattern->kind = WINDOW_RULE_PATTERN_SUFFIX;
+    } else {
+      pattern->kind = WINDOW_RULE_PATTERN_SUBSTRING;
+    }
+    pattern->literal = strndup(start, len);
+    pattern->literal_len = len;
+    return true;
+  }
+
+  if(regcomp(&pattern->regex, source, REG_EXTENDED | REG_NOSUB) != 0) {
+    wlr_log(WLR_ERROR, "%s is not a valid regex", source);
+    free(pattern->source);
+    pattern->source = NULL;
+    return false;
+  }
+  pattern->kind = WINDOW_RULE_PATTERN_REGEX;
+  return true;
+}
+
+void
+window_rule_pattern_finish(struct window_rule_pattern *pattern) {
+  if(pattern->kind == WINDOW_RULE_PATTERN_REGEX) {
+    regfree(&pattern->regex);
+  }
+  free(pattern->source);
+  free(pattern->literal);
+  *pattern = (struct window_rule_pattern){0};
+}
+
+bool
+window_rule_pattern_matches(struct window_rule_pattern *pattern, const char *string) {
+  if(pattern->kind == WINDOW_RULE_PATTERN_ANY) return true;
+  if(string == NULL) return false;
+
+  size_t len;
+  switch(pattern->kind) {
+    case WINDOW_RULE_PATTERN_EXACT:
+      return strcmp(string, pattern->literal) == 0;
+    case WINDOW_RULE_PATTERN_PREFIX:
+      return strncmp(string, pattern->literal, pattern->literal_len) == 0;
+    case WINDOW_RULE_PATTERN_SUFFIX:
+      len = strlen(string);
+      return len >= pattern->literal_len
+        && memcmp(string + len - pattern->literal_len,
+                  pattern->literal, pattern->literal_len) == 0;
+    case WINDOW_RULE_PATTERN_SUBSTRING:
+      return strstr(string, pattern->literal) != NULL;
+    case WINDOW_RULE_PATTERN_REGEX:
+      return regexec(&pattern->regex, string, 0, NULL, 0) == 0;
+    default:
+      return true;
+  }
+}
+
+bool
+window_rule_condition_matches(struct window_rule_condition *condition,
+                              const char *app_id, const char *title) {
+  return window_rule_pattern_matches(&condition->app_id, app_id)
+    && window_rule_pattern_matches(&condition->title, title);
+}
+
+bool
+window_rule_conditions_equal(struct window_rule_condition *a, struct window_rule_condition *b) {
+  return strcmp(a->app_id.source, b->app_id.source) == 0
+    && strcmp(a->title.source, b->title.source) == 0;
+}
+
+void
+window_rule_condition_finish(struct window_rule_condition *condition) {
+  window_rule_pattern_finish(&condition->app_id);
+  window_rule_pattern_finish(&condition->title);
+}
+
+void
+window_rule_cache_init(struct window_rule_cache *cache) {
+  for(size_t i = 0; i < WINDOW_RULE_CACHE_BUCKETS; i++) {
+    wl_list_init(&cache->buckets[i]);
+  }
+  wl_list_init(&cache->lru);
+  cache->count = 0;
+}
+
+void
+window_rule_cache_entry_destroy(struct window_rule_cache *cache,
+                                struct window_rule_cache_entry *entry) {
+  wl_list_remove(&entry->bucket_link);
+  wl_list_remove(&entry->lru_link);
+  free(entry->app_id);
+  free(entry->title);
+  free(entry);
+  cache->count--;
+}
+
+void
+window_rule_cache_finish(struct window_rule_cache *cache) {
+  struct window_rule_cache_entry *entry, *tmp;
+  wl_list_for_each_safe(entry, tmp, &cache->lru, lru_link) {
+    window_rule_cache_entry_destroy(cache, entry);
+  }
+}
+
+/* fnv-1a, with a marker so a missing string is different from an empty one */
+uint32_t
+window_rule_hash_string(uint32_t hash, const char *string) {
+  if(string == NULL) {
+    return (hash ^ 0xff) * 16777619u;
+  }
+  for(const char *c = string; *c != 0; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+  /* the terminator, so ("ab", "c") and ("a", "bc") hash differently */
+  return hash * 16777619u;
+}
+
+/* walks every rule list once and keeps the result, so a toplevel that is
+ * opened again or switches back to an old title does not touch the rules at all */
+struct window_rule_match *
+window_rules_match(struct mwc_config *c, const char *app_id, const char *title) {
+  struct window_rule_cache *cache = &c->window_rule_cache;
+  uint32_t hash = window_rule_hash_string(window_rule_hash_string(2166136261u, app_id), title);
+  struct wl_list *bucket = &cache->buckets[hash % WINDOW_RULE_CACHE_BUCKETS];
+
+  struct window_rule_cache_entry *entry;
+  wl_list_for_each(entry, bucket, bucket_link) {
+    if(entry->hash == hash
+       && strings_equal(entry->app_id, app_id)
+       && strings_equal(entry->title, title)) {
+      wl_list_remove(&entry->lru_link);
+      wl_list_insert(&cache->lru, &entry->lru_link);
+      return &entry->match;
+    }
+  }
+
+  if(cache->count >= WINDOW_RULE_CACHE_MAX) {
+    struct window_rule_cache_entry *oldest = wl_container_of(cache->lru.prev, oldest, lru_link);
+    window_rule_cache_entry_destroy(cache, oldest);
+  }
+
+  entry = calloc(1, sizeof(*entry));
+  entry->app_id = app_id == NULL ? NULL : strdup(app_id);
+  entry->title = title == NULL ? NULL : strdup(title);
+  entry->hash = hash;
+
+  struct window_rule_float *f;
+  wl_list_for_each(f, &c->window_rules.floating, link) {
+    if(window_rule_condition_matches(&f->condition, app_id, title)) {
+      entry->match.floating = true;
+      break;
+    }
+  }
+  struct window_rule_size *s;
+  wl_list_for_each(s, &c->window_rules.size, link) {
+    if(window_rule_condition_matches(&s->condition, app_id, title)) {
+      entry->match.size = s;
+      break;
+    }
+  }
+  struct window_rule_opacity *o;
+  wl_list_for_each(o, &c->window_rules.opacity, link) {
+    if(window_rule_condition_matches(&o->condition, app_id, title)) {
+      entry->match.opacity = o;
+      break;
+    }
+  }
+
+  wl_list_insert(bucket, &entry->bucket_link);
+  wl_list_insert(&cache->lru, &entry->lru_link);
+  cache->count++;
+
+  return &entry->match;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+#define WINDOW_RULE_CACHE_BUCKETS 64
+/* terminals put the current directory and command in the title, so without
+ * a bound the cache would grow for as long as the compositor runs */
+#define WINDOW_RULE_CACHE_MAX 256
+
+struct mwc_config;
+struct window_rule_size;
+struct window_rule_opacity;
+
+enum window_rule_pattern_kind {
+  /* "_", matches everything, even a missing app_id or title */
+  WINDOW_RULE_PATTERN_ANY,
+  /* the following are regexes without any special characters apart from anchors */
+  WINDOW_RULE_PATTERN_EXACT,
+  WINDOW_RULE_PATTERN_PREFIX,
+  WINDOW_RULE_PATTERN_SUFFIX,
+  WINDOW_RULE_PATTERN_SUBSTRING,
+  WINDOW_RULE_PATTERN_REGEX,
+};
+
+struct window_rule_pattern {
+  enum window_rule_pattern_kind kind;
+  /* as written in the config, used to compare rules on reload */
+  char *source;
+  /* the pattern without the anchors, only for the literal kinds */
+  char *literal;
+  size_t literal_len;
+  regex_t regex;
+};
+
+struct window_rule_condition {
+  struct window_rule_pattern app_id;
+  struct window_rule_pattern title;
+};
+
+/* the first rule of each kind that matches some app_id and title pair */
+struct window_rule_match {
+  bool floating;
+  struct window_rule_size *size;
+  struct window_rule_opacity *opacity;
+};
+
+struct window_rule_cache_entry {
+  char *app_id;
+  char *title;
+  uint32_t hash;
+  struct window_rule_match match;
+  struct wl_list bucket_link;
+  /* most recently used first */
+  struct wl_list lru_link;
+};
+
+/* lives in the config, so reloading it starts with an empty cache */
+struct window_rule_cache {
+  struct wl_list buckets[WINDOW_RULE_CACHE_BUCKETS];
+  struct wl_list lru;
+  size_t count;
+};
+
+bool
+window_rule_pattern_compile(struct window_rule_pattern *pattern, const char *source);
+
+void
+window_rule_pattern_finish(struct window_rule_pattern *pattern);
+
+bool
+window_rule_pattern_matches(struct window_rule_pattern *pattern, const char *string);
+
+bool
+window_rule_condition_matches(struct window_rule_condition *condition,
+                              const char *app_id, const char *title);
+
+bool
+window_rule_conditions_equal(struct window_rule_condition *a, struct window_rule_condition *b);
+
+void
+window_rule_condition_finish(struct window_rule_condition *condition);
+
+void
+window_rule_cache_init(struct window_rule_cache *cache);
+
+void
+window_rule_cache_finish(struct window_rule_cache *cache);
+
+struct window_rule_match *
+window_rules_match(struct mwc_config *c, const char *app_id, const char *title);
@@ -8,6 +8,7 @@
 #include "keybinds.h"
 #include "layer_surface.h"
 #include "something.h"
+#include "array.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -21,10 +22,13 @@ workspace_create_for_output(struct mwc_output *output, struct workspace_config *
   wl_list_init(&workspace->floating_toplevels);
   wl_list_init(&workspace->masters);
   wl_list_init(&workspace->slaves);
+  wl_list_init(&workspace->transaction.toplevels);
+  array_init(&workspace->tiles);
 
   workspace->output = output;
   workspace->index = config->index;
   workspace->config = config;
+  workspace->layout = config->layout != NULL ? config->layout : &layouts[0];
 
   wl_list_insert(&output->workspaces, &workspace->link);
 
@@ -116,6 +120,9 @@ change_workspace(struct mwc_workspace *workspace, bool keep_focus) {
   workspace->output->active_workspace = workspace;
   ipc_broadcast_message(IPC_ACTIVE_WORKSPACE);
 
+  /* toplevels that changed while hidden were not drawn */
+  workspace_schedule_dirty_toplevels(workspace);
+
   /* same as above */
   if(keep_focus) {
     /* do nothing */
@@ -142,6 +149,7 @@ toplevel_move_to_workspace(struct mwc_toplevel *toplevel,
      || workspace->fullscreen_toplevel != NULL) return;
 
   struct mwc_workspace *old_workspace = toplevel->workspace;
+  ipc_toplevel_changed();
 
   /* handle server state; note: even tho fullscreen toplevel is handled differently
    * we will still update its underlying type */
@@ -149,29 +157,21 @@ toplevel_move_to_workspace(struct mwc_toplevel *toplevel,
     toplevel->workspace = workspace;
     wl_list_remove(&toplevel->link);
     wl_list_insert(&workspace->floating_toplevels, &toplevel->link);
+    ipc_invalidate(IPC_QUERY_TOPLEVELS);
   } else if(toplevel_is_master(toplevel)){
-    wl_list_remove(&toplevel->link);
-    if(!wl_list_empty(&old_workspace->slaves)) {
+    layout_remove(toplevel);
+    if(old_workspace->slave_count > 0) {
       struct mwc_toplevel *s = wl_container_of(old_workspace->slaves.next, s, link);
-      wl_list_remove(&s->link);
-      wl_list_insert(old_workspace->masters.prev, &s->link);
+      layout_promote_slave(s);
     }
 
     toplevel->workspace = workspace;
-    if(wl_list_length(&workspace->masters) < server.config->master_count) {
-      wl_list_insert(workspace->masters.prev, &toplevel->link);
-    } else {
-      wl_list_insert(workspace->slaves.prev, &toplevel->link);
-    }
+    layout_append(toplevel);
   } else {
-    wl_list_remove(&toplevel->link);
+    layout_remove(toplevel);
 
     toplevel->workspace = workspace;
-    if(wl_list_length(&workspace->masters) < server.config->master_count) {
-      wl_list_insert(workspace->masters.prev, &toplevel->link);
-    } else {
-      wl_list_insert(workspace->slaves.prev, &toplevel->link);
-    }
+    layout_append(toplevel);
   }
 
   /* handle presentation */
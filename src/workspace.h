@@ -5,10 +5,12 @@
 #include "config.h"
 #include "toplevel.h"
 #include "output.h"
+#include "transaction.h"
 
 #include <wayland-server-protocol.h>
 
 struct mwc_animation;
+struct mwc_layout;
 
 struct mwc_workspace {
   struct wl_list link;
@@ -19,8 +21,17 @@ struct mwc_workspace {
 
   struct wl_list masters;
   struct wl_list slaves;
+  /* lengths of the lists above, they are only changed by the layout_* functions */
+  uint32_t master_count;
+  uint32_t slave_count;
   struct wl_list floating_toplevels;
   struct mwc_toplevel *fullscreen_toplevel;
+
+  struct mwc_transaction transaction;
+
+  const struct mwc_layout *layout;
+  /* result of the last layout pass, indexed by layout_index */
+  struct wlr_box *tiles;
 };
 
 void
@@ -1,2 +1,9 @@
 #define SEPARATOR "\x1E"
 #define IPC_PATH "/tmp/mwc/ipc"
+
+/* a request is a line "<id> <request>\n", where id is any number the client picks.
+ * every request gets exactly one "reply <id> <length>\n" followed by length bytes,
+ * events of a subscription are framed the same way as "event <id> <length>\n"
+ * with the id of the subscribe request. any number of requests can be sent over
+ * one connection without waiting for the replies */
+#define IPC_MAX_REQUEST 1024